@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <zstd.h>
+#include <sph/ranges/views/zstd_decode.h>
+#include <sph/ranges/views/zstd_encode.h>
+
+namespace
+{
+    /**
+     * How much uncompressed data each throughput benchmark works on.
+     */
+    constexpr size_t input_size{ static_cast<size_t>(4) * 1024 * 1024 };
+
+    /**
+     * How much uncompressed data each begin() benchmark works on. Small
+     * enough that setup dominates.
+     */
+    constexpr size_t message_size{ 256 };
+
+    /**
+     * A 24 byte record, standing in for the structs people compress.
+     */
+    struct sample
+    {
+        uint64_t timestamp;
+        double value;
+        uint32_t sensor;
+        uint32_t flags;
+    };
+    static_assert(sizeof(sample) == 24);
+
+    /**
+     * The input shapes the views read differently.
+     */
+    enum class shape : uint8_t
+    {
+        contiguous, // read in place
+        transform,  // read a value at a time
+        join        // read a value at a time across 4 KiB pieces
+    };
+
+    /**
+     * Make deterministic, moderately compressible values. Only uses the raw
+     * std::mt19937_64 output, which is the same on every standard library,
+     * so runs compare across platforms and releases.
+     * @tparam T The type of value to make.
+     * @param size The number of bytes of values to make.
+     * @return The values.
+     */
+    template<typename T>
+    auto make_input(size_t size) -> std::vector<T>
+    {
+        std::mt19937_64 rng{ 20240101 };
+        if constexpr (std::is_same_v<T, uint8_t>)
+        {
+            std::string text;
+            text.reserve(size + 64);
+            for (size_t i{ 0 }; text.size() < size; ++i)
+            {
+                text += std::format("{:010} sensor={:02} value={}\n", i, rng() % 64, rng() % 10'000);
+            }
+
+            text.resize(size);
+            return std::vector<uint8_t>(text.begin(), text.end());
+        }
+        else if constexpr (std::is_same_v<T, sample>)
+        {
+            std::vector<sample> ret(size / sizeof(sample));
+            uint64_t timestamp{ 1'700'000'000'000 };
+            for (auto& s : ret)
+            {
+                timestamp += rng() % 16;
+                s = sample{ .timestamp = timestamp, .value = static_cast<double>(rng() % 10'000) / 100.0, .sensor = static_cast<uint32_t>(rng() % 64), .flags = 0 };
+            }
+
+            return ret;
+        }
+        else
+        {
+            std::vector<T> ret(size / sizeof(T));
+            T counter{ 0 };
+            for (auto& v : ret)
+            {
+                counter += static_cast<T>(rng() % 16);
+                v = counter;
+            }
+
+            return ret;
+        }
+    }
+
+    /**
+     * Compress the way sph::views::zstd_encode does, but with the zstd
+     * streaming API directly and the input read in place. The same settings
+     * as stream_compress_old_school in the unit tests.
+     * @param input The bytes to compress.
+     * @param level The compression level.
+     * @return The compressed bytes.
+     */
+    auto raw_compress(std::span<uint8_t const> input, int level) -> std::vector<uint8_t>
+    {
+        std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> const ctx{ ZSTD_createCCtx(), &ZSTD_freeCCtx };
+        if (!ctx)
+        {
+            throw std::runtime_error("ZSTD_createCCtx() failed!");
+        }
+
+        ZSTD_CCtx_setParameter(ctx.get(), ZSTD_c_compressionLevel, level);
+        ZSTD_CCtx_setParameter(ctx.get(), ZSTD_c_checksumFlag, 1);
+        ZSTD_CCtx_setPledgedSrcSize(ctx.get(), input.size());
+        std::vector<uint8_t> ret;
+        ZSTD_inBuffer in{ input.data(), input.size(), 0 };
+        while (true)
+        {
+            size_t const out_pos{ ret.size() };
+            ret.resize(out_pos + ZSTD_CStreamOutSize());
+            ZSTD_outBuffer out{ ret.data(), ret.size(), out_pos };
+            size_t const remaining{ ZSTD_compressStream2(ctx.get(), &out, &in, ZSTD_e_end) };
+            if (ZSTD_isError(remaining))
+            {
+                throw std::runtime_error(std::format("ZSTD_compressStream2() failed: {}", ZSTD_getErrorName(remaining)));
+            }
+
+            ret.resize(out.pos);
+            if (remaining == 0)
+            {
+                return ret;
+            }
+        }
+    }
+
+    /**
+     * Decompress the way sph::views::zstd_decode does, but with the zstd
+     * streaming API directly and the input read in place.
+     * @param input The bytes to decompress.
+     * @return The decompressed bytes.
+     */
+    auto raw_decompress(std::span<uint8_t const> input) -> std::vector<uint8_t>
+    {
+        std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> const ctx{ ZSTD_createDCtx(), &ZSTD_freeDCtx };
+        if (!ctx)
+        {
+            throw std::runtime_error("ZSTD_createDCtx() failed!");
+        }
+
+        std::vector<uint8_t> ret;
+        ZSTD_inBuffer in{ input.data(), input.size(), 0 };
+        while (in.pos < in.size)
+        {
+            size_t const out_pos{ ret.size() };
+            ret.resize(out_pos + ZSTD_DStreamOutSize());
+            ZSTD_outBuffer out{ ret.data(), ret.size(), out_pos };
+            size_t const result{ ZSTD_decompressStream(ctx.get(), &out, &in) };
+            if (ZSTD_isError(result))
+            {
+                throw std::runtime_error(std::format("ZSTD_decompressStream() failed: {}", ZSTD_getErrorName(result)));
+            }
+
+            ret.resize(out.pos);
+        }
+
+        return ret;
+    }
+
+    /**
+     * Present bytes in the given shape.
+     * @tparam S The shape.
+     * @param whole The bytes, for the contiguous and transform shapes.
+     * @param pieces The bytes in pieces, for the join shape.
+     * @return A view of the bytes.
+     */
+    template<shape S>
+    auto shaped(std::vector<uint8_t> const& whole, std::vector<std::vector<uint8_t>> const& pieces)
+    {
+        if constexpr (S == shape::contiguous)
+        {
+            return std::views::all(whole);
+        }
+        else if constexpr (S == shape::transform)
+        {
+            return whole | std::views::transform([](uint8_t v) -> uint8_t { return v; });
+        }
+        else
+        {
+            return pieces | std::views::join;
+        }
+    }
+
+    /**
+     * Split bytes into 4 KiB pieces for the join shape.
+     * @param whole The bytes.
+     * @return The pieces.
+     */
+    auto split(std::vector<uint8_t> const& whole) -> std::vector<std::vector<uint8_t>>
+    {
+        std::vector<std::vector<uint8_t>> ret;
+        for (size_t pos{ 0 }; pos < whole.size(); pos += 4096)
+        {
+            auto const piece{ std::span{ whole }.subspan(pos, std::min<size_t>(4096, whole.size() - pos)) };
+            ret.emplace_back(piece.begin(), piece.end());
+        }
+
+        return ret;
+    }
+
+    /**
+     * Report throughput against the uncompressed size and the ratio achieved.
+     * @param state The benchmark state.
+     * @param uncompressed_size The uncompressed bytes handled per iteration.
+     * @param compressed_size The compressed bytes handled per iteration.
+     */
+    void set_throughput(benchmark::State& state, size_t uncompressed_size, size_t compressed_size)
+    {
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(uncompressed_size));
+        state.counters["ratio"] = static_cast<double>(uncompressed_size) / static_cast<double>(std::max<size_t>(compressed_size, 1));
+    }
+}
+
+// Compression throughput by level; compare against raw_compress_level.
+static void encode_level(benchmark::State& state)
+{
+    auto const input{ make_input<uint8_t>(input_size) };
+    int const level{ static_cast<int>(state.range(0)) };
+    size_t compressed_size{ 0 };
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto compressed{ input | sph::views::zstd_encode(level) | std::ranges::to<std::vector>() };
+        compressed_size = compressed.size();
+        benchmark::DoNotOptimize(compressed.data());
+    }
+
+    set_throughput(state, input.size(), compressed_size);
+}
+BENCHMARK(encode_level)->Arg(-5)->Arg(1)->Arg(3)->Arg(9)->Arg(19)->Unit(benchmark::kMillisecond);
+
+static void raw_compress_level(benchmark::State& state)
+{
+    auto const input{ make_input<uint8_t>(input_size) };
+    int const level{ static_cast<int>(state.range(0)) };
+    size_t compressed_size{ 0 };
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto compressed{ raw_compress(input, level) };
+        compressed_size = compressed.size();
+        benchmark::DoNotOptimize(compressed.data());
+    }
+
+    set_throughput(state, input.size(), compressed_size);
+}
+BENCHMARK(raw_compress_level)->Arg(-5)->Arg(1)->Arg(3)->Arg(9)->Arg(19)->Unit(benchmark::kMillisecond);
+
+// Decompression throughput by the level compressed at; compare against raw_decompress_level.
+static void decode_level(benchmark::State& state)
+{
+    auto const input{ make_input<uint8_t>(input_size) };
+    auto const compressed{ raw_compress(input, static_cast<int>(state.range(0))) };
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto decompressed{ compressed | sph::views::zstd_decode() | std::ranges::to<std::vector>() };
+        benchmark::DoNotOptimize(decompressed.data());
+    }
+
+    set_throughput(state, input.size(), compressed.size());
+}
+BENCHMARK(decode_level)->Arg(-5)->Arg(1)->Arg(3)->Arg(9)->Arg(19)->Unit(benchmark::kMillisecond);
+
+static void raw_decompress_level(benchmark::State& state)
+{
+    auto const input{ make_input<uint8_t>(input_size) };
+    auto const compressed{ raw_compress(input, static_cast<int>(state.range(0))) };
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto decompressed{ raw_decompress(compressed) };
+        benchmark::DoNotOptimize(decompressed.data());
+    }
+
+    set_throughput(state, input.size(), compressed.size());
+}
+BENCHMARK(raw_decompress_level)->Arg(-5)->Arg(1)->Arg(3)->Arg(9)->Arg(19)->Unit(benchmark::kMillisecond);
+
+// Compression throughput by the element type compressed from.
+template<typename T>
+static void encode_type(benchmark::State& state)
+{
+    auto const input{ make_input<T>(input_size) };
+    size_t compressed_size{ 0 };
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto compressed{ input | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+        compressed_size = compressed.size();
+        benchmark::DoNotOptimize(compressed.data());
+    }
+
+    set_throughput(state, input.size() * sizeof(T), compressed_size);
+}
+BENCHMARK_TEMPLATE(encode_type, uint8_t)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(encode_type, size_t)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(encode_type, sample)->Unit(benchmark::kMillisecond);
+
+// Decompression throughput by the element type decompressed into.
+template<typename T>
+static void decode_type(benchmark::State& state)
+{
+    auto const input{ make_input<T>(input_size) };
+    auto const compressed{ input | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto decompressed{ compressed | sph::views::zstd_decode<T>() | std::ranges::to<std::vector>() };
+        benchmark::DoNotOptimize(decompressed.data());
+    }
+
+    set_throughput(state, input.size() * sizeof(T), compressed.size());
+}
+BENCHMARK_TEMPLATE(decode_type, uint8_t)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(decode_type, size_t)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(decode_type, sample)->Unit(benchmark::kMillisecond);
+
+// Compression throughput by the shape of the input range.
+template<shape S>
+static void encode_shape(benchmark::State& state)
+{
+    auto const input{ make_input<uint8_t>(input_size) };
+    auto const pieces{ split(input) };
+    size_t compressed_size{ 0 };
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto compressed{ shaped<S>(input, pieces) | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+        compressed_size = compressed.size();
+        benchmark::DoNotOptimize(compressed.data());
+    }
+
+    set_throughput(state, input.size(), compressed_size);
+}
+BENCHMARK_TEMPLATE(encode_shape, shape::contiguous)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(encode_shape, shape::transform)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(encode_shape, shape::join)->Unit(benchmark::kMillisecond);
+
+// Decompression throughput by the shape of the compressed input range.
+template<shape S>
+static void decode_shape(benchmark::State& state)
+{
+    auto const input{ make_input<uint8_t>(input_size) };
+    auto const compressed{ raw_compress(input, ZSTD_CLEVEL_DEFAULT) };
+    auto const pieces{ split(compressed) };
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto decompressed{ shaped<S>(compressed, pieces) | sph::views::zstd_decode() | std::ranges::to<std::vector>() };
+        benchmark::DoNotOptimize(decompressed.data());
+    }
+
+    set_throughput(state, input.size(), compressed.size());
+}
+BENCHMARK_TEMPLATE(decode_shape, shape::contiguous)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(decode_shape, shape::transform)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(decode_shape, shape::join)->Unit(benchmark::kMillisecond);
+
+// The cost of begin() on a small message, which is mostly setting up the
+// context and buffers. Arg(1) takes them from a zstd_context_pool.
+static void encode_begin(benchmark::State& state)
+{
+    auto const input{ make_input<uint8_t>(message_size) };
+    sph::zstd_encode_parameters parameters{};
+    if (state.range(0) != 0)
+    {
+        parameters.pool = std::make_shared<sph::zstd_context_pool>();
+    }
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto view{ input | sph::views::zstd_encode(parameters) };
+        auto it{ view.begin() };
+        benchmark::DoNotOptimize(*it);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(encode_begin)->Arg(0)->Arg(1);
+
+static void decode_begin(benchmark::State& state)
+{
+    auto const input{ make_input<uint8_t>(message_size) };
+    auto const compressed{ raw_compress(input, ZSTD_CLEVEL_DEFAULT) };
+    sph::zstd_decode_parameters parameters{};
+    if (state.range(0) != 0)
+    {
+        parameters.pool = std::make_shared<sph::zstd_context_pool>();
+    }
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto view{ compressed | sph::views::zstd_decode(parameters) };
+        auto it{ view.begin() };
+        benchmark::DoNotOptimize(*it);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(decode_begin)->Arg(0)->Arg(1);
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+
+    benchmark::AddCustomContext("zstd_version", ZSTD_versionString());
+    benchmark::AddCustomContext("input_size", std::to_string(input_size));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,12 +1,22 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <deque>
 #include <doctest/doctest.h>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
+#include <memory_resource>
 #include <ranges>
+#include <string>
+#include <thread>
+#include <sph/ranges/views/zstd_async.h>
 #include <sph/ranges/views/zstd_decode.h>
+#include <sph/ranges/views/zstd_decode_chunks.h>
+#include <sph/ranges/views/zstd_decode_parallel.h>
 #include <sph/ranges/views/zstd_encode.h>
+#include <sph/ranges/views/zstd_into.h>
+#include <sph/ranges/views/zstd_seekable_decode.h>
+#include <sph/ranges/views/zstd_sink.h>
 #include <vector>
 
 #include "doctest_util.h"
@@ -75,6 +85,13 @@ namespace
             throw std::runtime_error(fmt::format("ZSTD_CCtx_setParameter(ZSTD_c_checksumFlag, 1) failed! {}", ZSTD_getErrorName(res)));
         }
 
+        /* The whole size is known up front, so let zstd know too. */
+        res = ZSTD_CCtx_setPledgedSrcSize(cctx, to_compress.size());
+        if (ZSTD_isError(res))
+        {
+            throw std::runtime_error(fmt::format("ZSTD_CCtx_setPledgedSrcSize({}) failed! {}", to_compress.size(), ZSTD_getErrorName(res)));
+        }
+
         if (thread_count > 1) {
             size_t const r = ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, thread_count);
             if (ZSTD_isError(r)) {
@@ -365,6 +382,1115 @@ TEST_CASE("zstd.multibyte_to_multibyte")
 }
 
 
+TEST_CASE("zstd.contiguous_input")
+{
+    // 16'384 size_t values exactly fill the default zstd input buffer
+    for (size_t const count : {static_cast<size_t>(1), static_cast<size_t>(1'000), static_cast<size_t>(16'384), static_cast<size_t>(100'000)})
+    {
+        auto truth{ std::views::iota(static_cast<size_t>(0), count) | std::ranges::to<std::vector>() };
+        auto contiguous{ truth | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+        auto from_span{ std::span<size_t const>(truth) | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+        auto staged{ std::deque<size_t>(truth.begin(), truth.end()) | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+        CHECK_EQ(contiguous, staged);
+        CHECK_EQ(from_span, staged);
+        auto check{ contiguous | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>() };
+        CHECK_EQ(check, truth);
+    }
+
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+
+TEST_CASE("zstd.contiguous_decode_input")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(100'000)) | std::ranges::to<std::vector>() };
+    auto compressed{ truth | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    auto from_vector{ compressed | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>() };
+    auto from_span{ std::span<uint8_t const>(compressed) | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>() };
+    auto staged{ std::deque<uint8_t>(compressed.begin(), compressed.end()) | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>() };
+    CHECK_EQ(from_vector, truth);
+    CHECK_EQ(from_span, truth);
+    CHECK_EQ(staged, truth);
+
+    auto compressed_multibyte{ truth | sph::views::zstd_encode<size_t>() | std::ranges::to<std::vector>() };
+    auto from_multibyte{ compressed_multibyte | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>() };
+    CHECK_EQ(from_multibyte, truth);
+
+    compressed.pop_back();
+    CHECK_THROWS_AS(std::ranges::distance(compressed | sph::views::zstd_decode<size_t>()), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+
+TEST_CASE("zstd.decode_chunks")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000'000)) | std::ranges::to<std::vector>() };
+    auto compressed{ truth | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    std::vector<size_t> check;
+    size_t chunk_count{ 0 };
+    for (auto chunk : compressed | sph::views::zstd_decode_chunks<size_t>())
+    {
+        check.insert(check.end(), chunk.begin(), chunk.end());
+        ++chunk_count;
+    }
+
+    CHECK_EQ(check, truth);
+    CHECK_LT(chunk_count, truth.size() / 1'000);
+
+    // 3 byte values straddle the zstd output buffer boundaries
+    using triple = std::array<uint8_t, 3>;
+    auto compressed_triples{ truth | std::views::take(999'999) | std::ranges::to<std::vector>() | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    std::vector<triple> check_triples;
+    for (auto chunk : compressed_triples | sph::views::zstd_decode_chunks<triple>())
+    {
+        check_triples.insert(check_triples.end(), chunk.begin(), chunk.end());
+    }
+
+    CHECK_EQ(check_triples.size(), 999'999 * sizeof(size_t) / sizeof(triple));
+    CHECK_EQ(check_triples, compressed_triples | sph::views::zstd_decode<triple>() | std::ranges::to<std::vector>());
+
+    auto compressed_multibyte{ truth | sph::views::zstd_encode<size_t>() | std::ranges::to<std::vector>() };
+    CHECK_EQ(std::ranges::distance(std::deque<size_t>(compressed_multibyte.begin(), compressed_multibyte.end()) | sph::views::zstd_decode_chunks<size_t>() | std::views::join), static_cast<std::ptrdiff_t>(truth.size()));
+    CHECK_THROWS_AS(std::ranges::distance(compressed | sph::views::zstd_decode_chunks<std::array<uint8_t, 7>>()), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+
+TEST_CASE("zstd.multibyte_seams")
+{
+    // values that don't evenly divide the zstd buffers straddle their boundaries
+    using triple = std::array<uint8_t, 3>;
+    using wide = std::array<uint8_t, 24>;
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(300'000)) | std::ranges::to<std::vector>() };
+    auto compressed{ truth | sph::views::zstd_encode<triple>() | std::ranges::to<std::vector>() };
+    CHECK_EQ(compressed | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    auto compressed_wide{ truth | sph::views::zstd_encode<wide>() | std::ranges::to<std::vector>() };
+    CHECK_EQ(compressed_wide | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+
+    auto bytes{ compressed | sph::views::zstd_decode() | std::ranges::to<std::vector>() };
+    auto wide_values{ compressed | sph::views::zstd_decode<wide>() | std::ranges::to<std::vector>() };
+    REQUIRE_EQ(wide_values.size() * sizeof(wide), bytes.size());
+    CHECK(std::ranges::equal(wide_values | std::views::join, bytes));
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+
+TEST_CASE("zstd.workers")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(2'000'000)) | std::ranges::to<std::vector>() };
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage-in-container"
+#endif
+    std::span<uint8_t const> truth_bytes(reinterpret_cast<uint8_t const*>(truth.data()), truth.size() * sizeof(size_t));
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+    sph::zstd_encode_parameters parameters{};
+    parameters.compression_level = 3;
+    auto single{ truth | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(single, truth | sph::views::zstd_encode(3) | std::ranges::to<std::vector>());
+    CHECK_EQ(single, stream_compress_old_school(truth_bytes, 3, 0));
+
+    parameters.workers = 4;
+    CHECK_EQ(truth | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>(), stream_compress_old_school(truth_bytes, 3, 4));
+
+    parameters.job_size = 1 << 20;
+    parameters.overlap_log = 5;
+    auto multi{ truth | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(multi | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+
+TEST_CASE("zstd.dictionary")
+{
+    std::vector<std::string> records;
+    for (size_t i{ 0 }; i < 4'000; ++i)
+    {
+        records.push_back(fmt::format(R"({{"id": {}, "name": "user_{}", "email": "user_{}@example.com", "active": {}, "score": {}}})", i, i * 7919 % 10'007, i, i % 3 == 0 ? "true" : "false", i * 31 % 1'000));
+    }
+
+    auto dictionary_bytes{ sph::zstd_train_dictionary(records, 4'096) };
+    CHECK_LE(dictionary_bytes.size(), 4'096);
+    sph::zstd_encode_parameters encode_parameters{};
+    encode_parameters.dictionary = sph::zstd_encode_dictionary{ dictionary_bytes, 3 };
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.dictionary = sph::zstd_decode_dictionary{ dictionary_bytes };
+    CHECK_NE(encode_parameters.dictionary.id(), 0);
+    CHECK_EQ(encode_parameters.dictionary.id(), decode_parameters.dictionary.id());
+
+    size_t with_dictionary_size{ 0 };
+    size_t without_dictionary_size{ 0 };
+    for (auto const& record : records | std::views::take(100))
+    {
+        auto with_dictionary{ record | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+        auto without_dictionary{ record | sph::views::zstd_encode(3) | std::ranges::to<std::vector>() };
+        with_dictionary_size += with_dictionary.size();
+        without_dictionary_size += without_dictionary.size();
+        CHECK_EQ(with_dictionary | sph::views::zstd_decode<char>(decode_parameters) | std::ranges::to<std::string>(), record);
+        CHECK_EQ(with_dictionary | sph::views::zstd_decode_chunks<char>(decode_parameters) | std::views::join | std::ranges::to<std::string>(), record);
+    }
+
+    CHECK_LT(with_dictionary_size * 2, without_dictionary_size);
+    auto compressed{ records.front() | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    CHECK_THROWS_AS(compressed | sph::views::zstd_decode<char>() | std::ranges::to<std::string>(), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} bytes with dictionary, {} without\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), with_dictionary_size, without_dictionary_size);
+}
+
+
+TEST_CASE("zstd.context_pool")
+{
+    std::vector<std::vector<uint32_t>> messages;
+    for (uint32_t i{ 0 }; i < 2'000; ++i)
+    {
+        messages.push_back(std::views::iota(i, i + 64) | std::ranges::to<std::vector>());
+    }
+
+    auto pool{ std::make_shared<sph::zstd_context_pool>() };
+    sph::zstd_encode_parameters encode_parameters{};
+    encode_parameters.compression_level = 3;
+    encode_parameters.pool = pool;
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.pool = pool;
+
+    auto const pooled_start{ std::chrono::steady_clock::now() };
+    std::vector<std::vector<uint8_t>> pooled;
+    for (auto const& message : messages)
+    {
+        pooled.push_back(message | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>());
+        CHECK_EQ(pooled.back() | sph::views::zstd_decode<uint32_t>(decode_parameters) | std::ranges::to<std::vector>(), message);
+    }
+
+    auto const pooled_elapsed{ std::chrono::duration<double>(std::chrono::steady_clock::now() - pooled_start).count() };
+    CHECK_EQ(pool->idle_cctx_count(), 1);
+    CHECK_EQ(pool->idle_dctx_count(), 1);
+
+    auto const unpooled_start{ std::chrono::steady_clock::now() };
+    for (auto const& [message, compressed] : std::views::zip(messages, pooled))
+    {
+        CHECK_EQ(message | sph::views::zstd_encode(3) | std::ranges::to<std::vector>(), compressed);
+        CHECK_EQ(compressed | sph::views::zstd_decode<uint32_t>() | std::ranges::to<std::vector>(), message);
+    }
+
+    auto const unpooled_elapsed{ std::chrono::duration<double>(std::chrono::steady_clock::now() - unpooled_start).count() };
+
+    // settings on one message must not leak into the next one from the same pool
+    encode_parameters.workers = 2;
+    auto const threaded{ messages.front() | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(threaded | sph::views::zstd_decode<uint32_t>(decode_parameters) | std::ranges::to<std::vector>(), messages.front());
+    encode_parameters.workers = 0;
+    CHECK_EQ(messages.front() | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>(), pooled.front());
+    fmt::print("{} {}/{}, {:0.5f} seconds, {:0.2f} us/message pooled, {:0.2f} us/message unpooled\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), pooled_elapsed * 1e6 / static_cast<double>(messages.size()), unpooled_elapsed * 1e6 / static_cast<double>(messages.size()));
+}
+
+
+TEST_CASE("zstd.memory_resource")
+{
+    // counts what goes through it so the test can tell the views used it and gave it all back
+    class counting_resource : public std::pmr::memory_resource
+    {
+    public:
+        size_t allocations{ 0 };
+        size_t outstanding{ 0 };
+        size_t max_bytes{ std::numeric_limits<size_t>::max() };
+    private:
+        auto do_allocate(size_t bytes, size_t alignment) -> void* override
+        {
+            if (bytes > max_bytes)
+            {
+                throw std::bad_alloc();
+            }
+
+            ++allocations;
+            outstanding += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            outstanding -= bytes;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        [[nodiscard]] auto do_is_equal(std::pmr::memory_resource const& other) const noexcept -> bool override { return this == &other; }
+    };
+
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000'000)) | std::ranges::to<std::vector>() };
+    counting_resource resource;
+    sph::zstd_encode_parameters encode_parameters{};
+    encode_parameters.compression_level = 3;
+    encode_parameters.memory_resource = &resource;
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.memory_resource = &resource;
+    auto compressed{ truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(compressed, truth | sph::views::zstd_encode(3) | std::ranges::to<std::vector>());
+    CHECK_EQ(compressed | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>(), truth);
+    CHECK_GT(resource.allocations, 0);
+    CHECK_EQ(resource.outstanding, 0);
+
+    // the seekable view's shared state and frame cache come from the resource too
+    {
+        sph::zstd_encode_parameters seekable_parameters{};
+        seekable_parameters.seekable_frame_size = static_cast<size_t>(64) * 1024;
+        auto const seekable{ truth | sph::views::zstd_encode(seekable_parameters) | std::ranges::to<std::vector>() };
+        size_t const before{ resource.allocations };
+        auto const column{ seekable | sph::views::zstd_seekable_decode<size_t>(decode_parameters) };
+        CHECK_EQ(column[654'321], 654'321);
+        CHECK_GE(resource.allocations, before + 3); // the state, the context, and the frame cache
+    }
+
+    CHECK_EQ(resource.outstanding, 0);
+
+    {
+        // a per-request arena; nothing gets freed until the arena goes away
+        std::pmr::monotonic_buffer_resource arena{ 1 << 20 };
+        encode_parameters.memory_resource = &arena;
+        decode_parameters.memory_resource = &arena;
+        CHECK_EQ(truth | sph::views::zstd_encode(encode_parameters) | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>(), truth);
+    }
+
+    size_t const allocations{ resource.allocations };
+    auto pool{ std::make_shared<sph::zstd_context_pool>(16, &resource) };
+    encode_parameters.memory_resource = nullptr;
+    encode_parameters.pool = pool;
+    CHECK_EQ(truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>(), compressed);
+    CHECK_GT(resource.allocations, allocations);
+    encode_parameters.pool.reset();
+    pool.reset();
+    CHECK_EQ(resource.outstanding, 0);
+
+    // the staging buffers are the only allocations that big before zstd runs; failing them must not leak the context
+    resource.max_bytes = ZSTD_DStreamOutSize() - 1;
+    encode_parameters.memory_resource = &resource;
+    decode_parameters.memory_resource = &resource;
+    CHECK_THROWS_AS(truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>(), std::bad_alloc);
+    CHECK_THROWS_AS(compressed | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>(), std::bad_alloc);
+    CHECK_EQ(resource.outstanding, 0);
+    pool = std::make_shared<sph::zstd_context_pool>(16, &resource);
+    encode_parameters.memory_resource = nullptr;
+    encode_parameters.pool = pool;
+    decode_parameters.memory_resource = nullptr;
+    decode_parameters.pool = pool;
+    CHECK_THROWS_AS(truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>(), std::bad_alloc);
+    CHECK_THROWS_AS(compressed | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>(), std::bad_alloc);
+    CHECK_EQ(pool->idle_cctx_count(), 1);
+    CHECK_EQ(pool->idle_dctx_count(), 1);
+    encode_parameters.pool.reset();
+    decode_parameters.pool.reset();
+    pool.reset();
+    CHECK_EQ(resource.outstanding, 0);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} allocations\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), resource.allocations);
+}
+
+
+TEST_CASE("zstd.workspace")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000'000)) | std::ranges::to<std::vector>() };
+    std::vector<uint8_t> encode_workspace(sph::zstd_encode_workspace_size(3));
+    sph::zstd_encode_parameters encode_parameters{};
+    encode_parameters.compression_level = 3;
+    encode_parameters.workspace = encode_workspace;
+    auto compressed{ truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(compressed, truth | sph::views::zstd_encode(3) | std::ranges::to<std::vector>());
+
+    // the workspace gets reused by the next view
+    CHECK_EQ(truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>(), compressed);
+
+    std::vector<uint8_t> decode_workspace(sph::zstd_decode_workspace_size(22));
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.window_log_max = 22;
+    decode_parameters.workspace = decode_workspace;
+    CHECK_EQ(compressed | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>(), truth);
+    CHECK_EQ(std::deque<uint8_t>(compressed.begin(), compressed.end()) | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>(), truth);
+
+    std::vector<uint8_t> small_workspace(sph::zstd_encode_workspace_size(1));
+    encode_parameters.compression_level = 19;
+    encode_parameters.workspace = small_workspace;
+    CHECK_THROWS_AS(truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>(), std::runtime_error);
+    encode_parameters.workspace = std::span<uint8_t>{ small_workspace }.first(1'000);
+    CHECK_THROWS_AS(truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>(), std::invalid_argument);
+    encode_parameters.workspace = encode_workspace;
+    encode_parameters.compression_level = 3;
+    encode_parameters.workers = 2;
+    CHECK_THROWS_AS(truth | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>(), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} byte encode workspace, {} byte decode workspace\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), encode_workspace.size(), decode_workspace.size());
+}
+
+
+TEST_CASE("zstd.pledged_size")
+{
+    for (size_t size : { static_cast<size_t>(0), static_cast<size_t>(1), static_cast<size_t>(1'000), static_cast<size_t>(16'384), static_cast<size_t>(100'000) })
+    {
+        auto truth{ std::views::iota(static_cast<size_t>(0), size) | std::ranges::to<std::vector>() };
+
+        // small enough contiguous input compresses in one shot; the deque streams; both pledge
+        auto one_shot{ truth | sph::views::zstd_encode(3) | std::ranges::to<std::vector>() };
+        CHECK_EQ(std::deque<size_t>(truth.begin(), truth.end()) | sph::views::zstd_encode(3) | std::ranges::to<std::vector>(), one_shot);
+        CHECK_EQ(ZSTD_getFrameContentSize(one_shot.data(), one_shot.size()), size * sizeof(size_t));
+        CHECK_EQ(one_shot | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+
+        // no size, no pledge; zstd still finds the size if it all fits in one input buffer
+        auto unsized{ truth | std::views::take_while([](size_t) { return true; }) | sph::views::zstd_encode(3) | std::ranges::to<std::vector>() };
+        if (size * sizeof(size_t) > ZSTD_CStreamInSize())
+        {
+            CHECK_EQ(ZSTD_getFrameContentSize(unsized.data(), unsized.size()), ZSTD_CONTENTSIZE_UNKNOWN);
+        }
+
+        CHECK_EQ(unsized | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    }
+
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+
+TEST_CASE("zstd.flush")
+{
+    // a live source: values made on the fly, counting how many got pulled
+    size_t pulled{ 0 };
+    auto source{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000'000)) | std::views::transform([&pulled](size_t v) { ++pulled; return v; }) };
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000'000)) | std::ranges::to<std::vector>() };
+
+    // without flushing, the first compressed byte waits on a lot of input
+    auto buffered{ source | sph::views::zstd_encode() };
+    std::ignore = buffered.begin();
+    size_t const buffered_pulled{ std::exchange(pulled, 0) };
+
+    sph::zstd_encode_parameters parameters{};
+    parameters.flush_size = 1'000 * sizeof(size_t);
+    auto flushed{ source | sph::views::zstd_encode(parameters) };
+    std::ignore = flushed.begin();
+    size_t const flushed_pulled{ pulled };
+    CHECK_LE(flushed_pulled, 1'000);
+    CHECK_LT(flushed_pulled, buffered_pulled);
+
+    auto const flushed_bytes{ flushed | std::ranges::to<std::vector>() };
+    auto const buffered_bytes{ buffered | std::ranges::to<std::vector>() };
+    CHECK_EQ(flushed_bytes | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    CHECK_EQ(buffered_bytes | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    CHECK_EQ(truth | sph::views::zstd_encode(parameters) | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} values in before first byte out flushed, {} not, {} bytes flushed, {} not\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), flushed_pulled, buffered_pulled, flushed_bytes.size(), buffered_bytes.size());
+}
+
+
+TEST_CASE("zstd.reserve_hint")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000'000)) | std::ranges::to<std::vector>() };
+    auto compressed{ truth | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    auto decoded{ compressed | sph::views::zstd_decode<size_t>() };
+    CHECK_EQ(decoded.reserve_hint(), truth.size());
+    std::vector<size_t> decompressed;
+    decompressed.reserve(decoded.reserve_hint());
+    std::ranges::copy(decoded, std::back_inserter(decompressed));
+    CHECK_EQ(decompressed, truth);
+    CHECK_EQ(decompressed.capacity(), truth.size());
+
+    // frames without a content size give no hint
+    auto unsized{ truth | std::views::take_while([](size_t) { return true; }) | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    CHECK_EQ((unsized | sph::views::zstd_decode<size_t>()).reserve_hint(), 0);
+
+    // small enough to decompress in one call, including a truncated one that must still throw
+    auto small{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000)) | std::ranges::to<std::vector>() };
+    auto small_compressed{ small | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    CHECK_EQ((small_compressed | sph::views::zstd_decode<size_t>()).reserve_hint(), small.size());
+    CHECK_EQ(small_compressed | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), small);
+    small_compressed.pop_back();
+    CHECK_EQ((small_compressed | sph::views::zstd_decode<size_t>()).reserve_hint(), 0);
+    CHECK_THROWS_AS(small_compressed | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+
+TEST_CASE("zstd.into")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(100'000)) | std::ranges::to<std::vector>() };
+    std::vector<uint8_t> compressed(ZSTD_compressBound(truth.size() * sizeof(size_t)));
+    auto const encoded{ sph::zstd_encode_into(truth, std::span{ compressed }) };
+    CHECK_GT(encoded.size(), 0);
+    CHECK_EQ(std::span{ encoded }.data(), compressed.data());
+    CHECK_EQ(encoded | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+
+    // contiguous input straight into the caller's memory
+    std::vector<size_t> decompressed(truth.size());
+    CHECK_EQ(sph::zstd_decode_into(encoded, std::span{ decompressed }).size(), truth.size());
+    CHECK_EQ(decompressed, truth);
+
+    // staged input, both ways, including data from a view that makes values on the fly
+    auto const staged_encoded{ sph::zstd_encode_into(std::views::iota(static_cast<size_t>(0), static_cast<size_t>(100'000)) | std::views::transform([](size_t v) { return v; }), std::span{ compressed }) };
+    std::deque<uint8_t> staged{ staged_encoded.begin(), staged_encoded.end() };
+    std::ranges::fill(decompressed, 0);
+    CHECK_EQ(sph::zstd_decode_into(staged, std::span{ decompressed }).size(), truth.size());
+    CHECK_EQ(decompressed, truth);
+
+    // too small output throws rather than truncating
+    std::vector<size_t> too_small(truth.size() - 1);
+    CHECK_THROWS_AS(sph::zstd_decode_into(encoded, std::span{ too_small }), std::invalid_argument);
+    CHECK_THROWS_AS(sph::zstd_decode_into(staged, std::span{ too_small }), std::invalid_argument);
+    std::vector<uint8_t> tiny(10);
+    CHECK_THROWS_AS(sph::zstd_encode_into(truth, std::span{ tiny }), std::invalid_argument);
+    CHECK_THROWS_AS(sph::zstd_encode_into(std::deque<size_t>{ truth.begin(), truth.end() }, std::span{ tiny }), std::invalid_argument);
+
+    // truncated input and partial values throw
+    staged.pop_back();
+    CHECK_THROWS_AS(sph::zstd_decode_into(staged, std::span{ decompressed }), std::invalid_argument);
+    CHECK_THROWS_AS(sph::zstd_decode_into(encoded.first(encoded.size() - 1), std::span{ decompressed }), std::invalid_argument);
+    std::array<uint8_t, 3> odd{ 1, 2, 3 };
+    std::vector<uint8_t> odd_compressed(ZSTD_compressBound(odd.size()));
+    auto const odd_encoded{ sph::zstd_encode_into(odd, std::span{ odd_compressed }) };
+    CHECK_THROWS_AS(sph::zstd_decode_into(odd_encoded, std::span{ decompressed }), std::invalid_argument);
+    std::vector<uint8_t> odd_decompressed(odd.size());
+    CHECK_EQ(sph::zstd_decode_into(odd_encoded, std::span{ odd_decompressed }).size(), odd.size());
+    CHECK(std::ranges::equal(odd, odd_decompressed));
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+
+TEST_CASE("zstd.decode_parallel")
+{
+    // an archive of many independent frames, some without a content size
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(4'000'000)) | std::ranges::to<std::vector>() };
+    std::vector<uint8_t> archive;
+    for (size_t index{ 0 }; index * 50'000 < truth.size(); ++index)
+    {
+        auto const block{ std::span{ truth }.subspan(index * 50'000, 50'000) };
+        if (index % 3 == 0)
+        {
+            std::ranges::copy(block | std::views::take_while([](size_t) { return true; }) | sph::views::zstd_encode(), std::back_inserter(archive));
+        }
+        else
+        {
+            std::ranges::copy(block | sph::views::zstd_encode(), std::back_inserter(archive));
+        }
+    }
+
+    auto tick{ std::chrono::steady_clock::now() };
+    auto const sequential{ archive | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>() };
+    double const sequential_seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - tick).count() };
+    tick = std::chrono::steady_clock::now();
+    auto const parallel{ archive | sph::views::zstd_decode_parallel<size_t>() | std::ranges::to<std::vector>() };
+    double const parallel_seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - tick).count() };
+    CHECK_EQ(sequential, truth);
+    CHECK_EQ(parallel, truth);
+    CHECK_EQ(archive | sph::views::zstd_decode_parallel<size_t>(1) | std::ranges::to<std::vector>(), truth);
+
+    // values straddling frames get put back together
+    std::vector<uint8_t> odd_frames;
+    auto const bytes{ std::views::iota(0, 3'000) | std::views::transform([](int i) { return static_cast<uint8_t>(i); }) | std::ranges::to<std::vector>() };
+    for (size_t index{ 0 }; index < bytes.size(); index += 7)
+    {
+        std::ranges::copy(std::span{ bytes }.subspan(index, std::min(static_cast<size_t>(7), bytes.size() - index)) | sph::views::zstd_encode(), std::back_inserter(odd_frames));
+    }
+
+    auto const odd_values{ odd_frames | sph::views::zstd_decode_parallel<uint32_t>(4) | std::ranges::to<std::vector>() };
+    REQUIRE_EQ(odd_values.size(), bytes.size() / sizeof(uint32_t));
+    CHECK(std::ranges::equal(std::span{ reinterpret_cast<uint8_t const*>(odd_values.data()), odd_values.size() * sizeof(uint32_t) }, bytes));
+    auto partial{ odd_frames };
+    std::ranges::copy(std::vector<uint8_t>{ 1 } | sph::views::zstd_encode(), std::back_inserter(partial));
+    CHECK_THROWS_AS(partial | sph::views::zstd_decode_parallel<uint32_t>() | std::ranges::to<std::vector>(), std::invalid_argument);
+
+    // workers take their contexts from the pool and give them back
+    auto pool{ std::make_shared<sph::zstd_context_pool>() };
+    sph::zstd_decode_parameters pooled{};
+    pooled.pool = pool;
+    CHECK_EQ(archive | sph::views::zstd_decode_parallel<size_t>(pooled, 4) | std::ranges::to<std::vector>(), truth);
+    CHECK_GE(pool->idle_dctx_count(), 1);
+    CHECK_LE(pool->idle_dctx_count(), 4);
+
+    // a header claiming 8 GiB for one byte gets streamed, not allocated up front, and window_log_max holds
+    std::vector<uint8_t> const liar{ 0x28, 0xb5, 0x2f, 0xfd, 0xe0, 0, 0, 0, 0, 2, 0, 0, 0, 0x09, 0, 0, 42 };
+    CHECK_THROWS_AS(liar | sph::views::zstd_decode_parallel<uint8_t>() | std::ranges::to<std::vector>(), std::invalid_argument);
+    sph::zstd_decode_parameters small_window{};
+    small_window.window_log_max = 10;
+    auto const one_frame{ std::span{ truth }.first(131'072) | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    CHECK_THROWS_AS(one_frame | sph::views::zstd_decode<size_t>(small_window) | std::ranges::to<std::vector>(), std::invalid_argument);
+    CHECK_THROWS_AS(one_frame | sph::views::zstd_decode_parallel<size_t>(small_window) | std::ranges::to<std::vector>(), std::invalid_argument);
+
+    // truncated archives throw
+    archive.pop_back();
+    CHECK_THROWS_AS(archive | sph::views::zstd_decode_parallel<size_t>() | std::ranges::to<std::vector>(), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {:0.3f} seconds sequential, {:0.3f} seconds parallel\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), sequential_seconds, parallel_seconds);
+}
+
+
+TEST_CASE("zstd.seekable")
+{
+    static_assert(std::ranges::random_access_range<decltype(std::declval<std::vector<uint8_t>&>() | sph::views::zstd_seekable_decode<size_t>())>);
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000'000)) | std::ranges::to<std::vector>() };
+    sph::zstd_encode_parameters parameters{};
+    parameters.seekable_frame_size = static_cast<size_t>(64) * 1024;
+    auto compressed{ truth | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(compressed | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    CHECK_EQ(compressed | sph::views::zstd_decode_parallel<size_t>() | std::ranges::to<std::vector>(), truth);
+    auto column{ compressed | sph::views::zstd_seekable_decode<size_t>() };
+    CHECK_EQ(column.size(), truth.size());
+    CHECK_EQ(column.frame_count(), (truth.size() * sizeof(size_t) + parameters.seekable_frame_size - 1) / parameters.seekable_frame_size);
+    CHECK_EQ(column[999'999], 999'999);
+    CHECK_EQ(column[0], 0);
+    CHECK_EQ(column[123'456], 123'456);
+    CHECK_EQ(*(column.end() - 2), 999'998);
+    CHECK_EQ(column | std::ranges::to<std::vector>(), truth);
+
+    // unsized input makes the same frames, just without content sizes
+    auto unsized{ truth | std::views::take_while([](size_t) { return true; }) | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(unsized | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    CHECK_EQ((unsized | sph::views::zstd_seekable_decode<size_t>())[654'321], 654'321);
+
+    // values straddling frames, frames ending right at the end of the input, and padding for wide output types
+    for (size_t frame_size : { static_cast<size_t>(1'000), static_cast<size_t>(8'000) })
+    {
+        parameters.seekable_frame_size = frame_size;
+        auto const small{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(10'000)) | std::ranges::to<std::vector>() };
+        auto const wide{ small | sph::views::zstd_encode<uint32_t>(parameters) | std::ranges::to<std::vector>() };
+        auto const small_column{ wide | sph::views::zstd_seekable_decode<size_t>() };
+        CHECK_EQ(small_column.frame_count(), small.size() * sizeof(size_t) / frame_size);
+        CHECK_EQ(small_column | std::ranges::to<std::vector>(), small);
+        std::deque<size_t> const staged{ small.begin(), small.end() };
+        CHECK_EQ(staged | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() | sph::views::zstd_seekable_decode<size_t>() | std::ranges::to<std::vector>(), small);
+    }
+
+    // a tampered seek table can't make the view allocate what it claims
+    auto const tamper{ [](std::vector<uint8_t> stream, size_t entry, uint32_t decompressed_size) -> std::vector<uint8_t>
+        {
+            size_t const frame_count{ static_cast<size_t>(stream[stream.size() - 9]) | (static_cast<size_t>(stream[stream.size() - 8]) << 8) | (static_cast<size_t>(stream[stream.size() - 7]) << 16) };
+            size_t const pos{ stream.size() - 9 - ((frame_count - entry) * 8) + 4 };
+            for (size_t i{ 0 }; i < sizeof(uint32_t); ++i)
+            {
+                stream[pos + i] = static_cast<uint8_t>(decompressed_size >> (i * 8));
+            }
+
+            return stream;
+        } };
+    CHECK_THROWS_AS(tamper(unsized, 0, 0xFFFF'FFFF) | sph::views::zstd_seekable_decode<uint8_t>(), std::invalid_argument);
+    CHECK_THROWS_AS(tamper(compressed, 3, 64 * 1024 - 8) | sph::views::zstd_seekable_decode<size_t>(), std::invalid_argument);
+    auto const oversized{ tamper(unsized, 0, 64 * 1024 + 8) };
+    CHECK_THROWS_AS((oversized | sph::views::zstd_seekable_decode<size_t>())[0], std::invalid_argument);
+
+    // the one-shot frame decompression still honors window_log_max
+    sph::zstd_decode_parameters small_window{};
+    small_window.window_log_max = 10;
+    auto const narrow{ compressed | sph::views::zstd_seekable_decode<size_t>(small_window) };
+    CHECK_THROWS_AS(narrow[0], std::invalid_argument);
+
+    // not seekable
+    auto plain{ truth | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    CHECK_THROWS_AS(plain | sph::views::zstd_seekable_decode<size_t>(), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} bytes seekable, {} bytes not\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), compressed.size(), plain.size());
+}
+
+
+TEST_CASE("zstd.async")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(2'000'000)) | std::ranges::to<std::vector>() };
+    auto const compressed{ truth | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    CHECK_EQ(truth | sph::views::zstd_encode_async() | std::ranges::to<std::vector>(), compressed);
+    CHECK_EQ(compressed | sph::views::zstd_decode_async<size_t>() | std::ranges::to<std::vector>(), truth);
+    CHECK_EQ(truth | sph::views::zstd_encode_async<uint32_t>({}, 1) | sph::views::zstd_decode_async<size_t>({}, 1) | std::ranges::to<std::vector>(), truth);
+
+    // whole compressed buffers get handed over, including a value padded out by a skippable frame
+    CHECK_EQ(truth | sph::views::zstd_encode_async<size_t>() | std::ranges::to<std::vector>(), truth | sph::views::zstd_encode<size_t>() | std::ranges::to<std::vector>());
+    auto const odd{ std::views::iota(0, 1'001) | std::views::transform([](int i) { return static_cast<uint8_t>(i * 13); }) | std::ranges::to<std::vector>() };
+    CHECK_EQ(odd | sph::views::zstd_encode_async<uint32_t>() | std::ranges::to<std::vector>(), odd | sph::views::zstd_encode<uint32_t>() | std::ranges::to<std::vector>());
+
+    // a slow consumer overlaps with the background thread
+    auto tick{ std::chrono::steady_clock::now() };
+    size_t count{ 0 };
+    for (size_t value : compressed | sph::views::zstd_decode_async<size_t>())
+    {
+        if (value % 65'536 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+        }
+
+        count += value == truth[count] ? 1U : 0U;
+    }
+
+    double const async_seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - tick).count() };
+    CHECK_EQ(count, truth.size());
+
+    // leaving early stops the background thread
+    {
+        auto decoded{ compressed | sph::views::zstd_decode_async<size_t>() };
+        auto it{ decoded.begin() };
+        CHECK_EQ(*it, 0);
+        ++it;
+        CHECK_EQ(*it, 1);
+    }
+
+    // errors from the background thread come out of the consumer
+    auto truncated{ compressed };
+    truncated.pop_back();
+    CHECK_THROWS_AS(truncated | sph::views::zstd_decode_async<size_t>() | std::ranges::to<std::vector>(), std::invalid_argument);
+    std::vector<uint8_t> const garbage(3, 1);
+    CHECK_THROWS_AS(garbage | sph::views::zstd_decode_async() | std::ranges::to<std::vector>(), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {:0.3f} seconds with a slow consumer\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), async_seconds);
+}
+
+TEST_CASE("zstd.read_ahead")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(2'000'000)) | std::ranges::to<std::vector>() };
+    auto const compressed{ truth | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    sph::zstd_decode_parameters parameters{};
+    parameters.read_ahead = true;
+
+    // an expensive input range
+    auto const slow{ [](uint8_t value) { for (int i{ 0 }; i < 10; ++i) { value = static_cast<uint8_t>(value ^ static_cast<uint8_t>(i)); } return value; } };
+    auto const read_slowly{ compressed | std::views::transform(slow) | std::views::transform(slow) };
+    auto tick{ std::chrono::steady_clock::now() };
+    CHECK_EQ(read_slowly | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+    double const plain_seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - tick).count() };
+    tick = std::chrono::steady_clock::now();
+    CHECK_EQ(read_slowly | sph::views::zstd_decode<size_t>(parameters) | std::ranges::to<std::vector>(), truth);
+    double const read_ahead_seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - tick).count() };
+
+    // multibyte input, chunks, and leaving early
+    auto const wide{ truth | sph::views::zstd_encode<uint32_t>() | std::ranges::to<std::deque>() };
+    CHECK_EQ(wide | sph::views::zstd_decode<size_t>(parameters) | std::ranges::to<std::vector>(), truth);
+    size_t chunked{ 0 };
+    for (std::span<size_t const> chunk : wide | sph::views::zstd_decode_chunks<size_t>(parameters))
+    {
+        chunked += chunk.size();
+    }
+
+    CHECK_EQ(chunked, truth.size());
+    CHECK_EQ(*(read_slowly | sph::views::zstd_decode<size_t>(parameters)).begin(), 0);
+
+    // errors reading or decompressing come out of the consumer
+    std::deque<uint8_t> truncated{ compressed.begin(), compressed.end() };
+    truncated.pop_back();
+    CHECK_THROWS_AS(truncated | sph::views::zstd_decode<size_t>(parameters) | std::ranges::to<std::vector>(), std::invalid_argument);
+    size_t read_count{ 0 };
+    auto const failing{ compressed | std::views::transform([&read_count, size = compressed.size()](uint8_t value) { if (++read_count == size / 2) { throw std::runtime_error("read failed"); } return value; }) };
+    CHECK_THROWS_AS(failing | sph::views::zstd_decode<size_t>(parameters) | std::ranges::to<std::vector>(), std::runtime_error);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {:0.3f} seconds plain, {:0.3f} seconds reading ahead\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), plain_seconds, read_ahead_seconds);
+}
+
+TEST_CASE("zstd.buffer_sizes")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(2'000'000)) | std::ranges::to<std::vector>() };
+    std::deque<size_t> const staged{ truth.begin(), truth.end() };
+    std::string curve;
+    for (size_t buffer_size : { static_cast<size_t>(1) /* clamped to 1 KiB */, static_cast<size_t>(16) * 1024, static_cast<size_t>(0), static_cast<size_t>(1024) * 1024, static_cast<size_t>(4) * 1024 * 1024 })
+    {
+        sph::zstd_encode_parameters encode_parameters{};
+        encode_parameters.in_buffer_size = buffer_size;
+        encode_parameters.out_buffer_size = buffer_size;
+        sph::zstd_decode_parameters decode_parameters{};
+        decode_parameters.in_buffer_size = buffer_size;
+        decode_parameters.out_buffer_size = buffer_size;
+        auto const tick{ std::chrono::steady_clock::now() };
+        auto const compressed{ staged | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::deque>() };
+        auto const uncompressed{ compressed | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>() };
+        double const seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - tick).count() };
+        CHECK_EQ(uncompressed, truth);
+        size_t chunk_max{ 0 };
+        for (std::span<size_t const> chunk : compressed | sph::views::zstd_decode_chunks<size_t>(decode_parameters))
+        {
+            chunk_max = std::max(chunk_max, chunk.size() * sizeof(size_t));
+        }
+
+        size_t const actual_size{ buffer_size == 0 ? ZSTD_DStreamOutSize() : std::max(buffer_size, static_cast<size_t>(1024)) };
+        CHECK_LE(chunk_max, actual_size);
+        double const mb{ static_cast<double>(truth.size() * sizeof(size_t)) / 1'000'000.0 };
+        curve += fmt::format(", {} byte buffers {:0.0f} MB/s {} KiB encode workspace", actual_size, mb / seconds, sph::zstd_encode_workspace_size(0, buffer_size, buffer_size) / 1024);
+    }
+
+    fmt::print("{} {}/{}, {:0.5f} seconds{}\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), curve);
+}
+
+TEST_CASE("zstd.advanced_parameters")
+{
+    // a 2 MiB random block repeated, so every repeat is farther back than a level 1 window reaches
+    uint64_t state{ 0x9E3779B97F4A7C15 };
+    auto const block{ std::views::iota(0, 2 * 1024 * 1024) | std::views::transform([&state](int) { state ^= state << 13; state ^= state >> 7; state ^= state << 17; return static_cast<uint8_t>(state); }) | std::ranges::to<std::vector>() };
+    std::vector<uint8_t> backup;
+    for (int i{ 0 }; i < 4; ++i)
+    {
+        backup.insert(backup.end(), block.begin(), block.end());
+    }
+
+    sph::zstd_encode_parameters parameters{};
+    parameters.compression_level = 1;
+    auto const plain{ backup | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    parameters.long_distance_matching = true;
+    auto const ldm{ backup | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_LT(ldm.size() * 2, plain.size());
+    CHECK_EQ(ldm | sph::views::zstd_decode() | std::ranges::to<std::vector>(), backup);
+
+    // a big enough window finds the repeats too
+    parameters.long_distance_matching = false;
+    parameters.window_log = 23;
+    auto const windowed{ backup | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_LT(windowed.size() * 2, plain.size());
+    CHECK_EQ(windowed | sph::views::zstd_decode() | std::ranges::to<std::vector>(), backup);
+
+    // out of range values get clamped rather than rejected
+    sph::zstd_encode_parameters clamped{};
+    clamped.window_log = 1;
+    clamped.hash_log = 100;
+    clamped.chain_log = 1;
+    clamped.search_log = 100;
+    clamped.min_match = 100;
+    clamped.target_length = -1;
+    clamped.strategy = static_cast<ZSTD_strategy>(15);
+    clamped.target_cblock_size = 1;
+    auto const small{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(10'000)) | std::ranges::to<std::vector>() };
+    CHECK_EQ(small | sph::views::zstd_encode(clamped) | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), small);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} bytes plain, {} bytes long distance matching, {} bytes 8 MiB window\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), plain.size(), ldm.size(), windowed.size());
+}
+
+TEST_CASE("zstd.frame_flags")
+{
+    auto truth{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(100'000)) | std::ranges::to<std::vector>() };
+    auto const plain{ truth | sph::views::zstd_encode() | std::ranges::to<std::vector>() };
+    CHECK_EQ(ZSTD_getFrameContentSize(plain.data(), plain.size()), truth.size() * sizeof(size_t));
+
+    // no checksum saves 4 bytes a frame
+    sph::zstd_encode_parameters parameters{};
+    parameters.disable_checksum = true;
+    auto const unchecked{ truth | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(unchecked.size() + 4, plain.size());
+    CHECK_EQ(unchecked | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+
+    // no content size, even though it is known
+    parameters.disable_content_size = true;
+    auto const unsized{ truth | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(ZSTD_getFrameContentSize(unsized.data(), unsized.size()), ZSTD_CONTENTSIZE_UNKNOWN);
+    CHECK_LT(unsized.size(), unchecked.size());
+    CHECK_EQ((unsized | sph::views::zstd_decode<size_t>()).reserve_hint(), 0);
+    CHECK_EQ(unsized | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), truth);
+
+    // the decoder can skip checking the checksum
+    auto corrupt_checksum{ plain };
+    corrupt_checksum.back() ^= 0xFF;
+    CHECK_THROWS_AS(corrupt_checksum | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), std::invalid_argument);
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.ignore_checksum = true;
+    CHECK_EQ(corrupt_checksum | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>(), truth);
+
+    // no dictionary ID
+    std::vector<std::string> records;
+    for (size_t i{ 0 }; i < 1'000; ++i)
+    {
+        records.push_back(fmt::format(R"({{"id": {}, "name": "user_{}", "active": {}}})", i, i * 7919 % 10'007, i % 3 == 0 ? "true" : "false"));
+    }
+
+    auto const dictionary_bytes{ sph::zstd_train_dictionary(records, 2'048) };
+    sph::zstd_encode_parameters dictionary_parameters{};
+    dictionary_parameters.dictionary = sph::zstd_encode_dictionary{ dictionary_bytes, 3 };
+    auto const with_id{ records.front() | sph::views::zstd_encode(dictionary_parameters) | std::ranges::to<std::vector>() };
+    dictionary_parameters.disable_dictionary_id = true;
+    auto const without_id{ records.front() | sph::views::zstd_encode(dictionary_parameters) | std::ranges::to<std::vector>() };
+    CHECK_NE(ZSTD_getDictID_fromFrame(with_id.data(), with_id.size()), 0);
+    CHECK_EQ(ZSTD_getDictID_fromFrame(without_id.data(), without_id.size()), 0);
+    CHECK_LT(without_id.size(), with_id.size());
+    decode_parameters.dictionary = sph::zstd_decode_dictionary{ dictionary_bytes };
+    CHECK_EQ(without_id | sph::views::zstd_decode<char>(decode_parameters) | std::ranges::to<std::string>(), records.front());
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} bytes, {} without checksum, {} without content size either\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), plain.size(), unchecked.size(), unsized.size());
+}
+
+TEST_CASE("zstd.adaptive_level")
+{
+    // text-like data where the level makes a visible difference
+    std::string text;
+    for (size_t i{ 0 }; text.size() < static_cast<size_t>(8) * 1024 * 1024; ++i)
+    {
+        text += fmt::format("{} user_{} logged in from 10.{}.{}.{} after {} ms\n", i * 7919 % 100'003, i * 31 % 9'973, i % 256, i * 7 % 256, i * 13 % 256, i * 17 % 1'000);
+    }
+
+    sph::zstd_encode_parameters parameters{};
+    parameters.seekable_frame_size = static_cast<size_t>(1024) * 1024;
+    parameters.compression_level = 9;
+    auto const fixed{ text | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+
+    // an unreachable throughput floor walks the level down a frame at a time
+    parameters.adaptive_min_speed = 1e9;
+    auto const down{ text | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_GT(down.size(), fixed.size());
+    CHECK_EQ(down | sph::views::zstd_decode<char>() | std::ranges::to<std::string>(), text);
+
+    // an easy floor walks it up; a CPU budget would make this depend on how busy the machine is
+    parameters.compression_level = 1;
+    parameters.adaptive_min_speed = 0.001;
+    parameters.adaptive_max_level = 9;
+    auto const up{ text | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    parameters.adaptive_min_speed = 0.0;
+    auto const level_one{ text | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    CHECK_LT(up.size(), level_one.size());
+    CHECK_EQ(up | sph::views::zstd_seekable_decode<char>() | std::ranges::to<std::string>(), text);
+
+    // without seekable frames a level change ends the frame
+    parameters.seekable_frame_size = 0;
+    parameters.compression_level = 9;
+    parameters.adaptive_min_speed = 0.0;
+    auto const single{ text | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    parameters.adaptive_min_speed = 1e9;
+    auto const frames{ text | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+    size_t frame_count{ 0 };
+    for (std::span<uint8_t const> remaining{ frames }; !remaining.empty(); ++frame_count)
+    {
+        size_t const frame_size{ ZSTD_findFrameCompressedSize(remaining.data(), remaining.size()) };
+        REQUIRE_FALSE(ZSTD_isError(frame_size));
+        remaining = remaining.subspan(frame_size);
+    }
+
+    CHECK_GT(frame_count, 1);
+    CHECK_GT(frames.size(), single.size());
+    CHECK_EQ(frames | sph::views::zstd_decode<char>() | std::ranges::to<std::string>(), text);
+
+    // with workers a call to zstd only queues a job, so there's nothing to time
+    parameters.workers = 2;
+    CHECK_THROWS_AS(text | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>(), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} bytes level 9, {} bytes adapting down, {} bytes level 1, {} bytes adapting up, {} frames adapting down\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), fixed.size(), down.size(), level_one.size(), up.size(), frame_count);
+}
+
+TEST_CASE("zstd.progress")
+{
+    auto const to_compress{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(1'000'000)) | std::ranges::to<std::vector>() };
+    uint64_t const uncompressed_size{ to_compress.size() * sizeof(size_t) };
+
+    std::vector<sph::zstd_progress> reports;
+    sph::zstd_encode_parameters encode_parameters{};
+    encode_parameters.progress_callback = [&reports](sph::zstd_progress const& progress) { reports.push_back(progress); };
+    encode_parameters.progress_interval = static_cast<size_t>(1024) * 1024;
+    auto const compressed{ to_compress | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    REQUIRE_GE(reports.size(), uncompressed_size / encode_parameters.progress_interval);
+    CHECK(std::ranges::is_sorted(reports, {}, &sph::zstd_progress::consumed));
+    CHECK_EQ(reports.back().consumed, uncompressed_size);
+    CHECK_EQ(reports.back().produced, compressed.size());
+    CHECK_EQ(reports.back().frame.ingested, uncompressed_size);
+    for (auto const& report : reports)
+    {
+        CHECK_EQ(report.frame.ingested, report.consumed); // single threaded, zstd holds on to nothing
+    }
+
+    // with workers, zstd reports what the workers are up to
+    reports.clear();
+    encode_parameters.workers = 2;
+    auto const threaded{ to_compress | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    REQUIRE_FALSE(reports.empty());
+    CHECK_EQ(reports.back().consumed, uncompressed_size);
+    CHECK_EQ(reports.back().produced, threaded.size());
+    CHECK_EQ(reports.back().frame.ingested, uncompressed_size);
+
+    // decoding counts compressed bytes toward the interval
+    reports.clear();
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.progress_callback = [&reports](sph::zstd_progress const& progress) { reports.push_back(progress); };
+    decode_parameters.progress_interval = 16 * 1024;
+    decode_parameters.in_buffer_size = 4 * 1024; // reports come between calls to zstd, so feed it less than an interval at a time
+    auto const decompressed{ compressed | std::views::transform([](uint8_t v) -> uint8_t { return v; }) | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>() };
+    CHECK_EQ(decompressed, to_compress);
+    REQUIRE_GE(reports.size(), compressed.size() / decode_parameters.progress_interval);
+    CHECK_EQ(reports.back().consumed, compressed.size());
+    CHECK_EQ(reports.back().produced, uncompressed_size);
+    CHECK_EQ(reports.back().frame.ingested, 0);
+
+    // in parallel, the totals come from the consuming thread as the runs get handed out
+    reports.clear();
+    encode_parameters.progress_callback = nullptr;
+    encode_parameters.workers = 0;
+    encode_parameters.seekable_frame_size = static_cast<size_t>(256) * 1024;
+    auto const framed{ to_compress | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    auto const consumer{ std::this_thread::get_id() };
+    bool off_thread{ false };
+    decode_parameters.progress_callback = [&reports, &off_thread, consumer](sph::zstd_progress const& progress)
+        {
+            off_thread = off_thread || std::this_thread::get_id() != consumer;
+            reports.push_back(progress);
+        };
+    CHECK_EQ(framed | sph::views::zstd_decode_parallel<size_t>(decode_parameters, 4) | std::ranges::to<std::vector>(), to_compress);
+    CHECK_FALSE(off_thread);
+    REQUIRE_GT(reports.size(), 1);
+    CHECK(std::ranges::is_sorted(reports, {}, &sph::zstd_progress::consumed));
+    CHECK(std::ranges::is_sorted(reports, {}, &sph::zstd_progress::produced));
+    CHECK_EQ(reports.back().consumed, framed.size());
+    CHECK_EQ(reports.back().produced, uncompressed_size);
+
+    // a throwing callback aborts the stream
+    decode_parameters.progress_callback = [](sph::zstd_progress const& progress)
+        {
+            if (progress.consumed > 0)
+            {
+                throw std::runtime_error("throttled");
+            }
+        };
+    CHECK_THROWS_AS(std::ignore = compressed | sph::views::zstd_decode(decode_parameters) | std::ranges::to<std::vector>(), std::runtime_error);
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+
+TEST_CASE("zstd.sinks")
+{
+    auto const to_compress{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(300'000)) | std::ranges::to<std::vector>() };
+    auto const pieces{ std::array<size_t, 4>{ 1, 5'000, 7, 100'000 } };
+
+    // pushed a piece at a time into an output iterator, with a flush in the middle
+    std::vector<uint8_t> compressed;
+    sph::zstd_encode_sink<std::back_insert_iterator<std::vector<uint8_t>>, size_t> encode_sink{ std::back_inserter(compressed) };
+    for (size_t pos{ 0 }, i{ 0 }; pos < to_compress.size(); ++i)
+    {
+        size_t const size{ std::min(pieces.at(i % pieces.size()), to_compress.size() - pos) };
+        encode_sink.write(std::span{ to_compress }.subspan(pos, size));
+        pos += size;
+        if (i == 3)
+        {
+            size_t const before{ compressed.size() };
+            encode_sink.flush();
+            CHECK_GT(compressed.size(), before);
+        }
+    }
+
+    encode_sink.finish();
+    CHECK_EQ(compressed | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>(), to_compress);
+
+    // writing after finish starts another frame
+    encode_sink.write(std::span{ to_compress }.first(1'000));
+    encode_sink.finish();
+    CHECK_EQ((compressed | sph::views::zstd_decode<size_t>() | std::ranges::to<std::vector>()).size(), to_compress.size() + 1'000);
+
+    // compressed blocks to a callable
+    std::vector<uint8_t> from_blocks;
+    size_t block_count{ 0 };
+    sph::zstd_encode_parameters encode_parameters{};
+    encode_parameters.out_buffer_size = 4 * 1024;
+    sph::zstd_encode_sink block_sink{ [&from_blocks, &block_count](std::span<uint8_t const> block)
+        {
+            CHECK_FALSE(block.empty());
+            from_blocks.insert(from_blocks.end(), block.begin(), block.end());
+            ++block_count;
+        }, encode_parameters };
+    auto const bytes{ to_compress | std::views::transform([](size_t v) -> uint8_t { return static_cast<uint8_t>(v * 7); }) | std::ranges::to<std::vector>() };
+    block_sink.write(bytes);
+    block_sink.finish();
+    CHECK_GT(block_count, 1);
+    CHECK_EQ(from_blocks | sph::views::zstd_decode() | std::ranges::to<std::vector>(), bytes);
+
+    // decompressed a few odd-sized pieces at a time, with values split across zstd output blocks
+    std::vector<size_t> decompressed;
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.out_buffer_size = 1'001;
+    sph::zstd_decode_sink<std::back_insert_iterator<std::vector<size_t>>, size_t> decode_sink{ std::back_inserter(decompressed), decode_parameters };
+    for (size_t pos{ 0 }; pos < compressed.size(); pos += 333)
+    {
+        decode_sink.write(std::span{ compressed }.subspan(pos, std::min(static_cast<size_t>(333), compressed.size() - pos)));
+    }
+
+    decode_sink.finish();
+    REQUIRE_EQ(decompressed.size(), to_compress.size() + 1'000);
+    CHECK(std::ranges::equal(std::span{ decompressed }.first(to_compress.size()), to_compress));
+
+    // decompressed blocks to a callable
+    size_t values{ 0 };
+    sph::zstd_decode_sink<std::function<void(std::span<size_t const>)>, size_t> counting_sink{ [&values](std::span<size_t const> block) { values += block.size(); } };
+    counting_sink.write(compressed);
+    counting_sink.finish();
+    CHECK_EQ(values, to_compress.size() + 1'000);
+
+    // stopping short of the end
+    sph::zstd_decode_sink truncated_sink{ [](std::span<uint8_t const>) {} };
+    truncated_sink.write(std::span{ from_blocks }.first(from_blocks.size() - 1));
+    CHECK_THROWS_AS(truncated_sink.finish(), std::invalid_argument);
+    sph::zstd_decode_sink<std::function<void(std::span<size_t const>)>, size_t> partial_sink{ [](std::span<size_t const>) {} };
+    partial_sink.write(std::span{ bytes }.first(1'001) | sph::views::zstd_encode() | std::ranges::to<std::vector>());
+    CHECK_THROWS_AS(partial_sink.finish(), std::invalid_argument);
+    fmt::print("{} {}/{}, {:0.5f} seconds, {} compressed blocks\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(), block_count);
+}
+
+#ifdef SPH_ZSTD_STATS
+TEST_CASE("zstd.stats")
+{
+    auto const to_compress{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(500'000)) | std::ranges::to<std::vector>() };
+    size_t const uncompressed_size{ to_compress.size() * sizeof(size_t) };
+
+    // queried off the iterator after iterating; non-contiguous input gets staged
+    auto const encode_view{ to_compress | std::views::transform([](size_t v) -> size_t { return v * 3; }) | sph::views::zstd_encode() };
+    std::vector<uint8_t> compressed;
+    auto encode_it{ encode_view.begin() };
+    for (; encode_it != encode_view.end(); ++encode_it)
+    {
+        compressed.push_back(*encode_it);
+    }
+
+    sph::zstd_stats const encoded{ encode_it.stats() };
+    CHECK_EQ(encoded.bytes_in, uncompressed_size);
+    CHECK_EQ(encoded.bytes_out, compressed.size());
+    CHECK_GT(encoded.zstd_calls, 1);
+    CHECK_GT(encoded.in_refills, 1);
+    CHECK_GT(encoded.out_refills, 0);
+    CHECK_GT(encoded.zstd_time.count(), 0);
+    CHECK_GT(encoded.staging_time.count(), 0);
+    CHECK_GT(encoded.value_time.count(), 0);
+
+    // reported once through the callback when the last iterator copy goes away
+    std::vector<sph::zstd_stats> reported;
+    sph::zstd_encode_parameters encode_parameters{};
+    encode_parameters.stats_callback = [&reported](sph::zstd_stats const& stats) { reported.push_back(stats); };
+    auto const contiguous_compressed{ to_compress | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    REQUIRE_EQ(reported.size(), 1);
+    CHECK_EQ(reported[0].bytes_in, uncompressed_size);
+    CHECK_EQ(reported[0].bytes_out, contiguous_compressed.size());
+
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.stats_callback = [&reported](sph::zstd_stats const& stats) { reported.push_back(stats); };
+    auto const decompressed{ compressed | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>() };
+    REQUIRE_EQ(reported.size(), 2);
+    CHECK_EQ(reported[1].bytes_in, compressed.size());
+    CHECK_EQ(reported[1].bytes_out, uncompressed_size);
+    CHECK_EQ(decompressed.size(), to_compress.size());
+
+    size_t chunk_bytes{ 0 };
+    auto const chunks_view{ compressed | sph::views::zstd_decode_chunks() };
+    auto chunks_it{ chunks_view.begin() };
+    for (; chunks_it != chunks_view.end(); ++chunks_it)
+    {
+        chunk_bytes += (*chunks_it).size();
+    }
+
+    CHECK_EQ(chunks_it.stats().bytes_out, chunk_bytes);
+    CHECK_GT(chunks_it.stats().out_refills, 1);
+
+    // the parallel workers' counters get added together and reported once
+    encode_parameters.stats_callback = nullptr;
+    encode_parameters.seekable_frame_size = static_cast<size_t>(256) * 1024;
+    auto const framed{ to_compress | sph::views::zstd_encode(encode_parameters) | std::ranges::to<std::vector>() };
+    reported.clear();
+    auto const parallel{ framed | sph::views::zstd_decode_parallel<size_t>(decode_parameters, 4) | std::ranges::to<std::vector>() };
+    CHECK_EQ(parallel, to_compress);
+    REQUIRE_EQ(reported.size(), 1);
+    CHECK_EQ(reported[0].bytes_out, uncompressed_size);
+    CHECK_EQ(reported[0].bytes_in, framed.size());
+    CHECK_GT(reported[0].zstd_calls, 1);
+    fmt::print("{} {}/{}, {:0.5f} seconds, encode zstd {} us, staging {} us, values {} us\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed(),
+        std::chrono::duration_cast<std::chrono::microseconds>(encoded.zstd_time).count(), std::chrono::duration_cast<std::chrono::microseconds>(encoded.staging_time).count(), std::chrono::duration_cast<std::chrono::microseconds>(encoded.value_time).count());
+}
+#else
+TEST_CASE("zstd.stats")
+{
+    auto const to_compress{ std::views::iota(static_cast<size_t>(0), static_cast<size_t>(100'000)) | std::ranges::to<std::vector>() };
+
+    // without the define the counters stay at zero and the callback never runs
+    size_t reports{ 0 };
+    sph::zstd_encode_parameters encode_parameters{};
+    encode_parameters.stats_callback = [&reports](sph::zstd_stats const&) { ++reports; };
+    auto const encode_view{ to_compress | sph::views::zstd_encode(encode_parameters) };
+    std::vector<uint8_t> compressed;
+    auto encode_it{ encode_view.begin() };
+    for (; encode_it != encode_view.end(); ++encode_it)
+    {
+        compressed.push_back(*encode_it);
+    }
+
+    CHECK_EQ(encode_it.stats().bytes_in, 0);
+    CHECK_EQ(encode_it.stats().zstd_calls, 0);
+
+    sph::zstd_decode_parameters decode_parameters{};
+    decode_parameters.stats_callback = [&reports](sph::zstd_stats const&) { ++reports; };
+    CHECK_EQ(compressed | sph::views::zstd_decode<size_t>(decode_parameters) | std::ranges::to<std::vector>(), to_compress);
+    CHECK_EQ(compressed | sph::views::zstd_decode_parallel<size_t>(decode_parameters, 2) | std::ranges::to<std::vector>(), to_compress);
+    CHECK_EQ(reports, 0);
+    fmt::print("{} {}/{}, {:0.5f} seconds\n", get_current_test_name(), get_current_test_assert_count() - get_current_test_assert_failed_count(), get_current_test_assert_count(), get_current_test_elapsed());
+}
+#endif
+
 TEST_CASE("zstd.levels")
 {
     std::string_view pinwheel{ "|/-\\" };
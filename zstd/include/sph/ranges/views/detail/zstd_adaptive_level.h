@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <zstd.h>
+#include <sph/ranges/views/detail/zstd_compress.h>
+
+namespace sph::ranges::views::detail
+{
+    /**
+     * Picks the compression level for an adaptive zstd_encode view.
+     *
+     * After each window of input it compares how fast zstd went, and how
+     * much of the elapsed time zstd took, against the targets in
+     * zstd_encode_parameters. Missing a target drops the level by one.
+     * Beating every target by a margin raises it by one.
+     */
+    class zstd_adaptive_level
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * The level gets looked at after this many input bytes.
+         */
+        static constexpr size_t window_size{ static_cast<size_t>(1024) * 1024 };
+    private:
+        double min_speed_; // bytes per second
+        double cpu_budget_;
+        int min_level_;
+        int max_level_;
+        int level_;
+        size_t window_in_{ 0 };
+        clock::duration window_zstd_{};
+        clock::time_point window_start_{ clock::now() };
+    public:
+        /**
+         * Initialize a new instance of the zstd_adaptive_level class.
+         * @param parameters The zstd compression parameters. Adaptive if
+         * adaptive_min_speed or adaptive_cpu_budget is set. Throws
+         * std::invalid_argument if adaptive with workers.
+         */
+        explicit zstd_adaptive_level(zstd_encode_parameters const& parameters)
+            : min_speed_{ std::max(0.0, parameters.adaptive_min_speed) * 1'000'000.0 }
+            , cpu_budget_{ std::max(0.0, parameters.adaptive_cpu_budget) }
+            , min_level_{ std::clamp(parameters.adaptive_min_level == 0 ? 1 : parameters.adaptive_min_level, ZSTD_minCLevel(), ZSTD_maxCLevel()) }
+            , max_level_{ std::clamp(parameters.adaptive_max_level == 0 ? 19 : parameters.adaptive_max_level, min_level_, ZSTD_maxCLevel()) }
+            , level_{ std::clamp(parameters.compression_level == 0 ? ZSTD_CLEVEL_DEFAULT : parameters.compression_level, min_level_, max_level_) }
+        {
+            if (enabled() && parameters.workers != 0)
+            {
+                // with workers a call to zstd mostly queues a job, so timing it says nothing about compression speed
+                throw std::invalid_argument("zstd_encode: An adaptive level can't be combined with workers.");
+            }
+        }
+
+        /**
+         * @return True if the level adapts.
+         */
+        [[nodiscard]] auto enabled() const -> bool { return min_speed_ > 0.0 || cpu_budget_ > 0.0; }
+
+        /**
+         * @return The level compression should be at.
+         */
+        [[nodiscard]] auto level() const -> int { return level_; }
+
+        /**
+         * Account for a call to zstd.
+         * @param in_size The number of input bytes zstd took.
+         * @param zstd_time How long the call took.
+         * @return True if level() changed.
+         */
+        auto record(size_t in_size, clock::duration zstd_time) -> bool
+        {
+            window_in_ += in_size;
+            window_zstd_ += zstd_time;
+            if (window_in_ < window_size)
+            {
+                return false;
+            }
+
+            auto const now{ clock::now() };
+            double const zstd_seconds{ std::max(std::chrono::duration<double>(window_zstd_).count(), 1e-9) };
+            double const elapsed_seconds{ std::max(std::chrono::duration<double>(now - window_start_).count(), zstd_seconds) };
+            double const speed{ static_cast<double>(window_in_) / zstd_seconds };
+            double const cpu{ zstd_seconds / elapsed_seconds };
+            window_in_ = 0;
+            window_zstd_ = {};
+            window_start_ = now;
+
+            int const previous{ level_ };
+            if ((min_speed_ > 0.0 && speed < min_speed_) || (cpu_budget_ > 0.0 && cpu > cpu_budget_))
+            {
+                level_ = std::max(level_ - 1, min_level_);
+            }
+            else if ((min_speed_ == 0.0 || speed > min_speed_ * 1.25) && (cpu_budget_ == 0.0 || cpu < cpu_budget_ * 0.8))
+            {
+                level_ = std::min(level_ + 1, max_level_);
+            }
+
+            return level_ != previous;
+        }
+    };
+}
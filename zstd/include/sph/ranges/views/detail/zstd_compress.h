@@ -3,10 +3,301 @@
 #include <cstdint>
 #include <format>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 #include <zstd.h>
 #include <zstd_errors.h>
+#include <sph/ranges/views/detail/zstd_context_pool.h>
+#include <sph/ranges/views/detail/zstd_dictionary.h>
+#include <sph/ranges/views/detail/zstd_memory.h>
+#include <sph/ranges/views/detail/zstd_progress.h>
+#include <sph/ranges/views/detail/zstd_stats.h>
+namespace sph
+{
+    /**
+     * Parameters for zstd compression.
+     *
+     * Zero leaves the zstd default in place for every member. Other values get
+     * clamped to the bounds the underlying zstd library reports.
+     */
+    struct zstd_encode_parameters
+    {
+        /**
+         * The zstd compression level. Clamped by ZSTD_minCLevel() and
+         * ZSTD_maxCLevel(), typically -131072 and 22.
+         */
+        int compression_level{ 0 };
+
+        /**
+         * The number of zstd worker threads to compress with. Zero compresses
+         * on the thread iterating the view. Otherwise, compression happens
+         * asynchronously on the worker threads. If the zstd library wasn't
+         * built with multithreading support, compression stays on the calling
+         * thread.
+         */
+        int workers{ 0 };
+
+        /**
+         * The size, in bytes, of each job handed to a worker thread; zero
+         * for the zstd default (typically 4 times the window size). Only
+         * used when workers is non-zero.
+         */
+        int job_size{ 0 };
+
+        /**
+         * How much of the window each job reloads from the previous job, from
+         * 1 (none) to 9 (the full window); zero for the zstd default. More
+         * overlap compresses better and slower. Only used when workers is
+         * non-zero.
+         */
+        int overlap_log{ 0 };
+
+        /**
+         * The largest back-reference distance, as a power of 2; zero for the
+         * level's default. Typically 10 through 30 (32-bit) or 31 (64-bit).
+         * Above 27 the decoder needs a matching window_log_max.
+         */
+        int window_log{ 0 };
+
+        /**
+         * The size of the initial match search table, as a power of 2; zero
+         * for the level's default. Bigger uses more memory and compresses
+         * better.
+         */
+        int hash_log{ 0 };
+
+        /**
+         * The size of the multi-probe search table, as a power of 2; zero for
+         * the level's default. Bigger uses more memory, compresses better,
+         * and compresses slower. Not used by the ZSTD_fast strategy.
+         */
+        int chain_log{ 0 };
+
+        /**
+         * The number of search attempts, as a power of 2; zero for the
+         * level's default. More searches compress better and slower.
+         */
+        int search_log{ 0 };
+
+        /**
+         * The shortest match searched for; zero for the level's default.
+         * Typically 3 through 7. Bigger compresses faster and worse.
+         */
+        int min_match{ 0 };
+
+        /**
+         * Strategy dependent: the match length the optimal parser stops
+         * looking beyond, or the acceleration of the ZSTD_fast strategy;
+         * zero for the level's default.
+         */
+        int target_length{ 0 };
+
+        /**
+         * The match finder, from ZSTD_fast through ZSTD_btultra2; the
+         * level's default if left value-initialized.
+         */
+        ZSTD_strategy strategy{};
+
+        /**
+         * True to enable long distance matching, which finds matches far
+         * back in a large window. Worth it for big inputs with distant
+         * repeats, such as deduplicated backup streams. Raises window_log to
+         * 27 unless it is set.
+         */
+        bool long_distance_matching{ false };
+
+        /**
+         * The size of the long distance matching table, as a power of 2;
+         * zero for the default, window_log - 7. Only used with
+         * long_distance_matching.
+         */
+        int ldm_hash_log{ 0 };
+
+        /**
+         * The compressed block size, in bytes, zstd tries to stay near so
+         * the decoder can start on data sooner; zero, the default, for no
+         * target. Costs some compression.
+         */
+        int target_cblock_size{ 0 };
+
+        /**
+         * True to leave the XXH64 checksum off each frame, saving a hash of
+         * every input byte and 4 bytes per frame; false, the default, to
+         * write it. For callers that already checksum at another layer.
+         */
+        bool disable_checksum{ false };
+
+        /**
+         * True to leave the decompressed size out of the frame header, even
+         * when it is known; false, the default, to write it when known.
+         * Without it, the decoder can't size its output up front, so
+         * reserve_hint() reports zero and one-shot decompression falls back
+         * to streaming.
+         */
+        bool disable_content_size{ false };
+
+        /**
+         * True to leave the dictionary ID out of the frame header when
+         * compressing with a dictionary; false, the default, to write it.
+         * Saves up to 4 bytes per frame. The decoder then can't tell a wrong
+         * dictionary from corrupt data.
+         */
+        bool disable_dictionary_id{ false };
+
+        /**
+         * The input throughput, in MB/s, zstd must keep up; zero, the
+         * default, for none. When set, or when adaptive_cpu_budget is, the
+         * level adapts: after each MiB of input it drops by one if zstd fell
+         * short and rises by one if zstd beat every target by a margin.
+         * Starts at compression_level. Zstd only takes a new level at the
+         * start of a frame, so a level change ends the frame unless
+         * seekable_frame_size is set, in which case it applies from the
+         * next seekable frame. Can't be combined with workers, whose calls
+         * to zstd queue jobs rather than compress, so can't be timed.
+         */
+        double adaptive_min_speed{ 0.0 };
+
+        /**
+         * The largest fraction, 0 through 1, of the time between level
+         * checks zstd may spend compressing; zero, the default, for no limit.
+         * A slow consumer leaves zstd idle, so the level rises to use the
+         * spare time. See adaptive_min_speed.
+         */
+        double adaptive_cpu_budget{ 0.0 };
+
+        /**
+         * The lowest level adapting may go to; zero for 1.
+         */
+        int adaptive_min_level{ 0 };
+
+        /**
+         * The highest level adapting may go to; zero for 19.
+         */
+        int adaptive_max_level{ 0 };
+
+        /**
+         * The dictionary to compress with; none by default. The dictionary's
+         * compression level supersedes compression_level. Decompress with
+         * the same dictionary.
+         */
+        zstd_encode_dictionary dictionary{};
+
+        /**
+         * The pool to take the compression context and buffers from; none
+         * by default, meaning each iterator allocates its own.
+         */
+        std::shared_ptr<zstd_context_pool> pool{};
+
+        /**
+         * The memory resource to allocate the compression context, its
+         * workspace, and the buffers from; nullptr, the default, for the
+         * default heap. Must outlive the view and its iterators. Not used for
+         * anything taken from a pool. With workers, zstd also allocates from
+         * the worker threads, so the resource must be thread-safe.
+         */
+        std::pmr::memory_resource* memory_resource{ nullptr };
+
+        /**
+         * Caller-owned memory to build the compression context and buffers
+         * in so compression doesn't allocate; empty, the default, to have
+         * them allocated. Size it with zstd_encode_workspace_size() and align
+         * it to at least 8 bytes. Takes precedence over pool and
+         * memory_resource, can't be combined with workers, and must outlive
+         * the view's iterators. Only one iterator can use it at a time.
+         */
+        std::span<uint8_t> workspace{};
+
+        /**
+         * The number of uncompressed bytes in each frame of a seekable
+         * stream; zero, the default, to write a single frame. Otherwise the
+         * output is a run of independent frames followed by a seek table in
+         * the zstd contrib seekable format, which zstd_seekable_decode can
+         * read from at random. Smaller frames make random reads cheaper and
+         * compress worse. Clamped to 1 GiB, the format's limit.
+         */
+        size_t seekable_frame_size{ 0 };
+
+        /**
+         * The number of uncompressed bytes after which zstd flushes what it
+         * has compressed so far; zero, the default, to let zstd buffer as
+         * it sees fit. For a live input range, such as a log or socket
+         * generator, this bounds how long input waits before its compressed
+         * bytes come out of the view. Each flush ends a zstd block early, so
+         * small values compress worse. The output stays a single frame;
+         * for independently decodable chunks, use seekable_frame_size.
+         */
+        size_t flush_size{ 0 };
+
+        /**
+         * The size, in bytes, of the buffer the input range gets staged in
+         * for zstd; zero, the default, for ZSTD_CStreamInSize(), about
+         * 128 KiB. Contiguous input gets handed to zstd this many bytes at a
+         * time. At least 1 KiB.
+         */
+        size_t in_buffer_size{ 0 };
+
+        /**
+         * The size, in bytes, of the buffer zstd compresses into; zero, the
+         * default, for ZSTD_CStreamOutSize(), about 128 KiB. At least 1 KiB.
+         *
+         * Smaller buffers save memory when many streams are open at once.
+         * Bigger ones spread the cost of each call to zstd over more bytes.
+         */
+        size_t out_buffer_size{ 0 };
+
+        /**
+         * Gets called with the stream's zstd_progress every
+         * progress_interval uncompressed bytes and when each frame ends;
+         * none, the default, for no reports. Runs on the thread doing the
+         * compressing, between calls to zstd, so it can also throttle by
+         * blocking. An exception it throws comes out of the iterator.
+         */
+        zstd_progress_callback progress_callback{};
+
+        /**
+         * The number of uncompressed bytes between calls to
+         * progress_callback; zero, the default, for every 1 MiB. Checked
+         * after each call to zstd, so a report comes at the first call past
+         * each interval.
+         */
+        size_t progress_interval{ 0 };
+
+        /**
+         * Gets handed the stream's zstd_stats when the last copy of its
+         * iterator goes away; none by default. Runs on whichever thread that
+         * happens on and must not throw. Only called with SPH_ZSTD_STATS
+         * defined.
+         */
+        zstd_stats_callback stats_callback{};
+    };
+
+    /**
+     * Get the workspace size zstd compression needs at the given level.
+     *
+     * Covers the compression context, from ZSTD_estimateCStreamSize(), and
+     * the staging buffers. A dictionary, or a window_log, hash_log, or
+     * chain_log above the level's defaults, can need more.
+     *
+     * @param compression_level The zstd compression level. Clamped by
+     * ZSTD_minCLevel() and ZSTD_maxCLevel().
+     * @param in_buffer_size The zstd_encode_parameters::in_buffer_size that
+     * will go with the workspace.
+     * @param out_buffer_size The zstd_encode_parameters::out_buffer_size
+     * that will go with the workspace.
+     * @return The number of bytes for zstd_encode_parameters::workspace.
+     */
+    inline auto zstd_encode_workspace_size(int compression_level, size_t in_buffer_size = 0, size_t out_buffer_size = 0) -> size_t
+    {
+        return ZSTD_estimateCStreamSize(std::clamp(compression_level, ZSTD_minCLevel(), ZSTD_maxCLevel()))
+            + ranges::views::detail::zstd_staging_size(in_buffer_size, ZSTD_CStreamInSize())
+            + ranges::views::detail::zstd_staging_size(out_buffer_size, ZSTD_CStreamOutSize())
+            + alignof(std::max_align_t);
+    }
+}
+
 namespace sph::ranges::views::detail
 {
     /**
@@ -15,28 +306,43 @@ namespace sph::ranges::views::detail
      */
     class zstd_compress_buf
     {
-        size_t in_max_size_{ ZSTD_CStreamInSize() };
-        size_t out_max_size_{ ZSTD_CStreamOutSize() };
-        std::vector<uint8_t> buf_;
+        size_t in_max_size_;
+        size_t out_max_size_;
+        zstd_buffer buf_;
         ZSTD_inBuffer in_buf_;
         ZSTD_outBuffer out_buf_;
     public:
-        zstd_compress_buf()
-            : buf_(in_max_size_ + out_max_size_)
-            , in_buf_{buf_.data(), in_max_size_, in_max_size_}
+        zstd_compress_buf() : zstd_compress_buf(zstd_buffer{}) {}
+        /**
+         * Initialize a new instance of the zstd_compress_buf class.
+         * @param buf The storage to use for the buffers, typically from a
+         * zstd_context_pool. Gets resized to fit.
+         * @param in_max_size The size of the input buffer.
+         * @param out_max_size The size of the output buffer. Zero if the
+         * output always goes to memory owned by someone else.
+         */
+        explicit zstd_compress_buf(zstd_buffer buf, size_t in_max_size = ZSTD_CStreamInSize(), size_t out_max_size = ZSTD_CStreamOutSize())
+            : in_max_size_{ in_max_size }
+            , out_max_size_{ out_max_size }
+            , buf_(std::move(buf))
+            , in_buf_{}
+            , out_buf_{}
+        {
+            buf_.resize(in_max_size_ + out_max_size_);
+            in_buf_ = ZSTD_inBuffer{ buf_.data(), in_max_size_, in_max_size_ };
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
 #endif
-            , out_buf_{ buf_.data() + in_max_size_, out_max_size_, out_max_size_ }
+            out_buf_ = ZSTD_outBuffer{ buf_.data() + in_max_size_, out_max_size_, out_max_size_ };
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
-        {}
-        zstd_compress_buf(zstd_compress_buf const&) = default;
+        }
+        zstd_compress_buf(zstd_compress_buf const&) = delete;
         zstd_compress_buf(zstd_compress_buf &&) = default;
         ~zstd_compress_buf() = default;
-        zstd_compress_buf &operator=(zstd_compress_buf const&) = default;
+        zstd_compress_buf &operator=(zstd_compress_buf const&) = delete;
         zstd_compress_buf &operator=(zstd_compress_buf&&) = default;
         auto in() -> ZSTD_inBuffer& { return in_buf_; }
         [[nodiscard]] auto in_pos() const -> size_t { return in_buf_.pos; }
@@ -44,6 +350,19 @@ namespace sph::ranges::views::detail
         auto out() -> ZSTD_outBuffer& { return out_buf_; }
             [[nodiscard]] auto out_pos() const -> size_t { return out_buf_.pos; }
         auto out_max_size() const -> size_t { return out_max_size_; }
+
+        /**
+         * @param in_max_size The size of the input buffer.
+         * @param out_max_size The size of the output buffer.
+         * @return The number of bytes of storage the buffers need.
+         */
+        static auto buffer_size(size_t in_max_size = ZSTD_CStreamInSize(), size_t out_max_size = ZSTD_CStreamOutSize()) -> size_t { return in_max_size + out_max_size; }
+
+        /**
+         * Give up the storage, typically to return it to a zstd_context_pool.
+         * The buffers are unusable afterwards.
+         */
+        auto release() -> zstd_buffer { return std::move(buf_); }
     };
 
     /**
@@ -62,33 +381,184 @@ namespace sph::ranges::views::detail
          */
         struct zstd_data
         {
-            ZSTD_CCtx* ctx{};
+            /**
+             * Returns the context to the pool it came from or frees it.
+             */
+            struct ctx_release
+            {
+                zstd_context_pool* pool{ nullptr };
+                void operator()(ZSTD_CCtx* ctx) const
+                {
+                    if (pool != nullptr)
+                    {
+                        pool->release(ctx);
+                    }
+                    else
+                    {
+                        ZSTD_freeCCtx(ctx); // a no-op for a context in a caller-supplied workspace
+                    }
+                }
+            };
+
+            std::shared_ptr<zstd_context_pool> pool;
+            std::unique_ptr<ZSTD_CCtx, ctx_release> ctx; // owned from the start so a later member failing to build doesn't leak it
             zstd_compress_buf buf{};
-            explicit zstd_data(int level) : ctx{ init_ctx(level) } {}
+            zstd_encode_dictionary dictionary; // keeps the dictionary ctx references alive
+            zstd_stats_recorder stats;
+            zstd_progress_reporter progress;
+            /**
+             * Initialize a new instance of the zstd_data class.
+             * @param parameters The zstd compression parameters.
+             * @param in_max_size The size of the input buffer.
+             * @param out_max_size The size of the output buffer. Zero if the
+             * output always goes to memory owned by someone else.
+             */
+            zstd_data(zstd_encode_parameters const& parameters, size_t in_max_size, size_t out_max_size)
+                : pool{ parameters.workspace.empty() ? parameters.pool : nullptr }
+                , ctx{ init_ctx(parameters, zstd_compress_buf::buffer_size(in_max_size, out_max_size), pool.get()) }
+                , buf{ init_buf(parameters, zstd_compress_buf::buffer_size(in_max_size, out_max_size), pool.get()), in_max_size, out_max_size }
+                , dictionary{ parameters.dictionary }
+                , stats{ parameters }
+                , progress{ parameters } {}
             zstd_data(zstd_data const&) = delete;
             zstd_data(zstd_data&&) = default;
-            ~zstd_data() { ZSTD_freeCCtx(ctx); }
+            ~zstd_data()
+            {
+                ctx.reset(); // ahead of the dictionary it references
+                if (pool)
+                {
+                    pool->release(buf.release());
+                }
+            }
             auto operator=(zstd_data const&)->zstd_data & = delete;
             auto operator=(zstd_data&&)->zstd_data & = default;
         private:
-            static auto init_ctx(int level) -> ZSTD_CCtx*
+            static auto init_ctx(zstd_encode_parameters const& parameters, size_t buffer_size, zstd_context_pool* pool) -> std::unique_ptr<ZSTD_CCtx, ctx_release>
             {
-                auto ret{ ZSTD_createCCtx() };
+                std::unique_ptr<ZSTD_CCtx, ctx_release> ret{ nullptr, ctx_release{ pool } };
+                if (!parameters.workspace.empty())
+                {
+                    if (parameters.workers != 0)
+                    {
+                        throw std::invalid_argument("zstd_encode: A workspace can't be combined with workers.");
+                    }
+
+                    auto const context_workspace{ zstd_split_workspace(parameters.workspace, buffer_size).first };
+                    ret.reset(ZSTD_initStaticCCtx(context_workspace.data(), context_workspace.size()));
+                    if (ret != nullptr)
+                    {
+                        // a static context starts out zeroed rather than with the defaults (content size flag on), so apply them
+                        ZSTD_CCtx_reset(ret.get(), ZSTD_reset_parameters);
+                    }
+                }
+                else
+                {
+                    ret.reset(pool != nullptr ? pool->acquire_cctx() : zstd_create_cctx(parameters.memory_resource));
+                }
+
                 if (ret == nullptr)
                 {
                     throw std::runtime_error("Failed to create zstd compress context.");
                 }
 
-                ZSTD_CCtx_setParameter(ret, ZSTD_c_compressionLevel, std::clamp(level, ZSTD_minCLevel(), ZSTD_maxCLevel()));
-                ZSTD_CCtx_setParameter(ret, ZSTD_c_checksumFlag, 1);
+                ZSTD_CCtx_setParameter(ret.get(), ZSTD_c_compressionLevel, std::clamp(parameters.compression_level, ZSTD_minCLevel(), ZSTD_maxCLevel()));
+                ZSTD_CCtx_setParameter(ret.get(), ZSTD_c_checksumFlag, parameters.disable_checksum ? 0 : 1);
+                ZSTD_CCtx_setParameter(ret.get(), ZSTD_c_contentSizeFlag, parameters.disable_content_size ? 0 : 1);
+                ZSTD_CCtx_setParameter(ret.get(), ZSTD_c_dictIDFlag, parameters.disable_dictionary_id ? 0 : 1);
+                if (parameters.workers != 0)
+                {
+                    set_parameter(ret.get(), ZSTD_c_nbWorkers, parameters.workers);
+                    set_parameter(ret.get(), ZSTD_c_jobSize, parameters.job_size);
+                    set_parameter(ret.get(), ZSTD_c_overlapLog, parameters.overlap_log);
+                }
+
+                set_parameter(ret.get(), ZSTD_c_windowLog, parameters.window_log);
+                set_parameter(ret.get(), ZSTD_c_hashLog, parameters.hash_log);
+                set_parameter(ret.get(), ZSTD_c_chainLog, parameters.chain_log);
+                set_parameter(ret.get(), ZSTD_c_searchLog, parameters.search_log);
+                set_parameter(ret.get(), ZSTD_c_minMatch, parameters.min_match);
+                set_parameter(ret.get(), ZSTD_c_targetLength, parameters.target_length);
+                set_parameter(ret.get(), ZSTD_c_strategy, static_cast<int>(parameters.strategy));
+                if (parameters.long_distance_matching)
+                {
+                    set_parameter(ret.get(), ZSTD_c_enableLongDistanceMatching, 1);
+                    set_parameter(ret.get(), ZSTD_c_ldmHashLog, parameters.ldm_hash_log);
+                }
+
+                set_parameter(ret.get(), ZSTD_c_targetCBlockSize, parameters.target_cblock_size);
+
+                if (parameters.dictionary)
+                {
+                    if (size_t const result{ ZSTD_CCtx_refCDict(ret.get(), parameters.dictionary.get()) }; ZSTD_isError(result))
+                    {
+                        throw std::runtime_error(std::format("Failed to set zstd compression dictionary: {}.", ZSTD_getErrorName(result)));
+                    }
+                }
+
                 return ret;
             }
+
+            static auto init_buf(zstd_encode_parameters const& parameters, size_t buffer_size, zstd_context_pool* pool) -> zstd_buffer
+            {
+                if (!parameters.workspace.empty())
+                {
+                    return zstd_buffer{ zstd_split_workspace(parameters.workspace, buffer_size).second };
+                }
+
+                return pool != nullptr ? pool->acquire_buffer() : zstd_buffer{ parameters.memory_resource };
+            }
+
+            /**
+             * Set the given parameter on the context if it isn't zero.
+             * @param ctx The context to set the parameter on.
+             * @param parameter The parameter to set.
+             * @param value The value to set. Clamped to the bounds reported
+             * by ZSTD_cParam_getBounds().
+             */
+            static void set_parameter(ZSTD_CCtx* ctx, ZSTD_cParameter parameter, int value)
+            {
+                if (value == 0)
+                {
+                    return;
+                }
+
+                auto const [bounds_result, lower_bound, upper_bound]{ ZSTD_cParam_getBounds(parameter) };
+                if (ZSTD_isError(bounds_result))
+                {
+                    throw std::runtime_error(std::format("Failed to get zstd compress context bounds: {}.", ZSTD_getErrorName(bounds_result)));
+                }
+
+                if (size_t const result{ ZSTD_CCtx_setParameter(ctx, parameter, std::clamp(value, lower_bound, upper_bound)) }; ZSTD_isError(result))
+                {
+                    throw std::runtime_error(std::format("Failed to set zstd compress context parameter: {}.", ZSTD_getErrorName(result)));
+                }
+            }
         };
 
         std::shared_ptr<zstd_data> data_;
         bool can_compress_{ true };
     public:
-        zstd_compressor(int level = 0) : data_{ std::make_shared<zstd_data>(level) } {}
+        zstd_compressor() : zstd_compressor(zstd_encode_parameters{}) {}
+        /**
+         * Initialize a new instance of the zstd_compressor class with the
+         * buffer sizes the parameters ask for.
+         * @param parameters The zstd compression parameters.
+         */
+        explicit zstd_compressor(zstd_encode_parameters const& parameters)
+            : zstd_compressor(parameters, zstd_staging_size(parameters.in_buffer_size, ZSTD_CStreamInSize()), zstd_staging_size(parameters.out_buffer_size, ZSTD_CStreamOutSize())) {}
+        /**
+         * Initialize a new instance of the zstd_compressor class.
+         * @param parameters The zstd compression parameters.
+         * @param in_max_size The size of the input buffer.
+         * @param out_max_size The size of the output buffer. Zero if the
+         * output always goes to memory owned by the caller through
+         * compress_to().
+         */
+        zstd_compressor(zstd_encode_parameters const& parameters, size_t in_max_size, size_t out_max_size)
+            : data_{ parameters.memory_resource == nullptr
+                ? std::make_shared<zstd_data>(parameters, in_max_size, out_max_size)
+                : std::allocate_shared<zstd_data>(std::pmr::polymorphic_allocator<zstd_data>{ parameters.memory_resource }, parameters, in_max_size, out_max_size) }
+        {}
         zstd_compressor(zstd_compressor const& o)
             : data_{ o.data_ }
             , can_compress_{ false } // only one copy can compress
@@ -117,43 +587,183 @@ namespace sph::ranges::views::detail
         [[nodiscard]] auto out_pos() const -> size_t { return data_->buf.out().pos; }
         [[nodiscard]] auto out_size() const -> size_t { return data_->buf.out().size; }
         [[nodiscard]] auto out_max_size() const -> size_t { return data_->buf.out_max_size(); }
+        [[nodiscard]] auto recorder() const -> zstd_stats_recorder& { return data_->stats; }
 
         /**
-         * Compress the data in the in() buffer (along with any remaining data
-         * in the compression pipeline) into the out() buffer.
+         * Tell zstd how many bytes it will get before the end of the frame.
          *
-         * Expects either in() pos < size or remaining content in the
-         * compression pipeline (or both).
+         * Zstd writes the size into the frame header and sizes its window
+         * and tables to fit, which makes compressing and decompressing small
+         * inputs cheaper. Compressing any other number of bytes fails.
          *
-         * Sets out() pos=0 and size to the number of compressed bytes.
+         * Must be called before the first compression.
+         *
+         * @param size The number of bytes that will get compressed.
+         */
+        void pledge(unsigned long long size) const
+        {
+            if (size_t const result{ ZSTD_CCtx_setPledgedSrcSize(data_->ctx.get(), size) }; ZSTD_isError(result))
+            {
+                throw std::runtime_error(std::format("Failed to set zstd pledged source size: {}.", ZSTD_getErrorName(result)));
+            }
+        }
+
+        /**
+         * Change the compression level.
+         *
+         * With workers, the new level applies from the next job. Otherwise
+         * it applies from the next frame.
+         *
+         * @param level The compression level. Clamped by ZSTD_minCLevel() and
+         * ZSTD_maxCLevel().
+         */
+        void set_level(int level) const
+        {
+            if (size_t const result{ ZSTD_CCtx_setParameter(data_->ctx.get(), ZSTD_c_compressionLevel, std::clamp(level, ZSTD_minCLevel(), ZSTD_maxCLevel())) }; ZSTD_isError(result))
+            {
+                throw std::runtime_error(std::format("Failed to set zstd compression level: {}.", ZSTD_getErrorName(result)));
+            }
+        }
+
+        /**
+         * Compress the whole input in one call, straight into the out()
+         * buffer, if the out() buffer is guaranteed to hold the result.
+         *
+         * Must be called before any other compression. Sets out() pos=0 and
+         * size to the number of compressed bytes.
          *
+         * @param src The input to compress.
+         * @param size The number of bytes to compress.
+         * @return True if compressed; false if the input is too big, in
+         * which case nothing happened.
+         */
+        [[nodiscard]] auto compress_once(uint8_t const* src, size_t size) const -> bool
+        {
+            if (ZSTD_compressBound(size) > data_->buf.out_max_size())
+            {
+                return false;
+            }
+
+            auto& o{ data_->buf.out() };
+            o.size = compress_to(src, size, static_cast<uint8_t*>(o.dst), data_->buf.out_max_size());
+            o.pos = 0;
+            return true;
+        }
+
+        /**
+         * Compress the whole input in one call straight into memory owned by
+         * the caller, bypassing out().
+         *
+         * Must be called before any other compression.
+         *
+         * @param src The input to compress.
+         * @param size The number of bytes to compress.
+         * @param dst Where to put the compressed bytes.
+         * @param capacity The number of bytes available at dst. Throws
+         * std::invalid_argument if the compressed bytes don't fit.
+         * @return The number of compressed bytes.
+         */
+        auto compress_to(uint8_t const* src, size_t size, uint8_t* dst, size_t capacity) const -> size_t
+        {
+            if (!can_compress_)
+            {
+                throw std::logic_error("Only one copy of the zstd compressor can compress. You probably made a copy of the iterator and tried to use it. Moving the iterator is fine.");
+            }
+
+            auto const call{ data_->stats.begin_zstd(0, 0) };
+            size_t const res{ ZSTD_compress2(data_->ctx.get(), dst, capacity, src, size) };
+            if (ZSTD_isError(res))
+            {
+                throw_error(res);
+            }
+
+            data_->stats.end_zstd(call, size, res);
+            if (data_->progress.enabled())
+            {
+                data_->progress.record(size, res, true, [this] { return ZSTD_getFrameProgression(data_->ctx.get()); });
+            }
+
+            return res;
+        }
+
+        /**
+         * Compress the data in the in() buffer (along with any remaining data
+         * in the compression pipeline) straight into memory owned by the
+         * caller, bypassing out().
+         *
+         * @param out Where to put the compressed bytes. Compressed bytes get
+         * written starting at pos, which gets advanced past them.
          * @param mode ZSTD_e_continue if there will be more input data;
          * ZSTD_e_end if there won't.
-         * @return True if there remains data in the compression pipeline to
-         * put into out(); false otherwise.
+         * @return The number of bytes zstd still has to flush; zero once
+         * fully flushed.
          */
-        [[nodiscard]] auto operator()(ZSTD_EndDirective mode) const -> bool
+        auto compress_to(ZSTD_outBuffer& out, ZSTD_EndDirective mode) const -> size_t
         {
             if (!can_compress_)
             {
                 throw std::logic_error("Only one copy of the zstd compressor can compress. You probably made a copy of the iterator and tried to use it. Moving the iterator is fine.");
             }
 
-            auto &o{ data_->buf.out() };
-            auto &i{ data_->buf.in() };
-            o.pos = 0;
-            o.size = data_->buf.out_max_size();
-            size_t const res{ ZSTD_compressStream2(data_->ctx, &o, &i, mode) };
+            size_t const in_pos{ data_->buf.in().pos };
+            size_t const out_pos{ out.pos };
+            auto const call{ data_->stats.begin_zstd(in_pos, out_pos) };
+            size_t const res{ ZSTD_compressStream2(data_->ctx.get(), &out, &data_->buf.in(), mode) };
             if (ZSTD_isError(res))
             {
-                ZSTD_ErrorCode const err{ ZSTD_getErrorCode(res) };
-                ZSTD_CCtx_reset(data_->ctx, ZSTD_reset_session_only);
-                throw std::runtime_error(std::format("zstd failed compression: {}.", ZSTD_getErrorString(err)));
+                throw_error(res);
+            }
+
+            data_->stats.end_zstd(call, data_->buf.in().pos, out.pos);
+            if (data_->progress.enabled())
+            {
+                data_->progress.record(data_->buf.in().pos - in_pos, out.pos - out_pos, mode == ZSTD_e_end && res == 0, [this] { return ZSTD_getFrameProgression(data_->ctx.get()); });
             }
 
+            return res;
+        }
+
+        /**
+         * Compress the data in the in() buffer (along with any remaining data
+         * in the compression pipeline) into the out() buffer.
+         *
+         * Expects either in() pos < size or remaining content in the
+         * compression pipeline (or both).
+         *
+         * Sets out() pos=0 and size to the number of compressed bytes.
+         *
+         * @param mode ZSTD_e_continue if there will be more input data;
+         * ZSTD_e_flush to push everything so far out of the pipeline;
+         * ZSTD_e_end if there won't be more input data.
+         * @return True if mode is ZSTD_e_flush or ZSTD_e_end and the
+         * pipeline has been fully flushed into out(); false otherwise.
+         */
+        [[nodiscard]] auto operator()(ZSTD_EndDirective mode) const -> bool
+        {
+            auto &o{ data_->buf.out() };
+            o.pos = 0;
+            o.size = data_->buf.out_max_size();
+            size_t const res{ compress_to(o, mode) };
             o.size = o.pos;
             o.pos = 0;
-            return mode == ZSTD_e_end && res == 0;
+            return mode != ZSTD_e_continue && res == 0;
+        }
+
+    private:
+        /**
+         * Reset the session and throw the exception for the given zstd error.
+         * @param result The failed zstd result.
+         */
+        [[noreturn]] void throw_error(size_t result) const
+        {
+            ZSTD_ErrorCode const err{ ZSTD_getErrorCode(result) };
+            ZSTD_CCtx_reset(data_->ctx.get(), ZSTD_reset_session_only);
+            if (err == ZSTD_error_dstSize_tooSmall)
+            {
+                throw std::invalid_argument(std::format("zstd failed compression: {}.", ZSTD_getErrorString(err)));
+            }
+
+            throw std::runtime_error(std::format("zstd failed compression: {}.", ZSTD_getErrorString(err)));
         }
     };
 }
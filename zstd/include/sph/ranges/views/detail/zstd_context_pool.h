@@ -0,0 +1,205 @@
+#pragma once
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <zstd.h>
+#include <sph/ranges/views/detail/zstd_memory.h>
+namespace sph
+{
+    /**
+     * A thread-safe pool of zstd contexts and buffers.
+     *
+     * Each zstd_encode or zstd_decode iterator normally creates its own zstd
+     * context and a few hundred KiB of buffers, then frees them when the last
+     * copy of the iterator goes away. For a lot of small messages, that
+     * churn costs more than the compression. Hand a pool to the views through
+     * zstd_encode_parameters or zstd_decode_parameters and the iterators
+     * take their contexts and buffers from the pool and give them back when
+     * done.
+     *
+     * Contexts get reset, session and parameters, on the way back into the
+     * pool so the next iterator starts clean.
+     *
+     * Share the pool through a std::shared_ptr. Iterators hold a reference
+     * so the pool outlives them.
+     *
+     * Everything the pool creates comes from the pool's memory resource, not
+     * the memory resource in the view parameters.
+     */
+    class zstd_context_pool
+    {
+        mutable std::mutex mutex_;
+        size_t max_idle_;
+        std::pmr::memory_resource* memory_resource_;
+        std::vector<ZSTD_CCtx*> cctxs_;
+        std::vector<ZSTD_DCtx*> dctxs_;
+        std::vector<ranges::views::detail::zstd_buffer> buffers_;
+    public:
+        /**
+         * Initialize a new instance of the zstd_context_pool class.
+         * @param max_idle The maximum number of idle compression contexts,
+         * decompression contexts, and buffers, each, to keep. Anything
+         * returned beyond that gets freed.
+         * @param memory_resource The memory resource to allocate contexts
+         * and buffers from; nullptr for the default heap. Must outlive the
+         * pool.
+         */
+        explicit zstd_context_pool(size_t max_idle = 16, std::pmr::memory_resource* memory_resource = nullptr)
+            : max_idle_{ max_idle }, memory_resource_{ memory_resource } {}
+        zstd_context_pool(zstd_context_pool const&) = delete;
+        zstd_context_pool(zstd_context_pool&&) = delete;
+        ~zstd_context_pool()
+        {
+            for (auto* ctx : cctxs_)
+            {
+                ZSTD_freeCCtx(ctx);
+            }
+
+            for (auto* ctx : dctxs_)
+            {
+                ZSTD_freeDCtx(ctx);
+            }
+        }
+
+        auto operator=(zstd_context_pool const&) -> zstd_context_pool& = delete;
+        auto operator=(zstd_context_pool&&) -> zstd_context_pool& = delete;
+
+        /**
+         * @return An idle compression context or, if none, a new one; nullptr
+         * if creating a new one failed.
+         */
+        [[nodiscard]] auto acquire_cctx() -> ZSTD_CCtx*
+        {
+            {
+                std::lock_guard const lock{ mutex_ };
+                if (!cctxs_.empty())
+                {
+                    auto* const ret{ cctxs_.back() };
+                    cctxs_.pop_back();
+                    return ret;
+                }
+            }
+
+            return ranges::views::detail::zstd_create_cctx(memory_resource_);
+        }
+
+        /**
+         * @return An idle decompression context or, if none, a new one;
+         * nullptr if creating a new one failed.
+         */
+        [[nodiscard]] auto acquire_dctx() -> ZSTD_DCtx*
+        {
+            {
+                std::lock_guard const lock{ mutex_ };
+                if (!dctxs_.empty())
+                {
+                    auto* const ret{ dctxs_.back() };
+                    dctxs_.pop_back();
+                    return ret;
+                }
+            }
+
+            return ranges::views::detail::zstd_create_dctx(memory_resource_);
+        }
+
+        /**
+         * @return An idle buffer or, if none, an empty one. The caller
+         * resizes it as needed.
+         */
+        [[nodiscard]] auto acquire_buffer() -> ranges::views::detail::zstd_buffer
+        {
+            std::lock_guard const lock{ mutex_ };
+            if (buffers_.empty())
+            {
+                return ranges::views::detail::zstd_buffer{ memory_resource_ };
+            }
+
+            auto ret{ std::move(buffers_.back()) };
+            buffers_.pop_back();
+            return ret;
+        }
+
+        /**
+         * Return a compression context to the pool.
+         * @param ctx The context to return. Gets reset or, if the pool is
+         * full, freed.
+         */
+        void release(ZSTD_CCtx* ctx)
+        {
+            if (ctx == nullptr)
+            {
+                return;
+            }
+
+            if (!ZSTD_isError(ZSTD_CCtx_reset(ctx, ZSTD_reset_session_and_parameters)))
+            {
+                std::lock_guard const lock{ mutex_ };
+                if (cctxs_.size() < max_idle_)
+                {
+                    cctxs_.push_back(ctx);
+                    return;
+                }
+            }
+
+            ZSTD_freeCCtx(ctx);
+        }
+
+        /**
+         * Return a decompression context to the pool.
+         * @param ctx The context to return. Gets reset or, if the pool is
+         * full, freed.
+         */
+        void release(ZSTD_DCtx* ctx)
+        {
+            if (ctx == nullptr)
+            {
+                return;
+            }
+
+            if (!ZSTD_isError(ZSTD_DCtx_reset(ctx, ZSTD_reset_session_and_parameters)))
+            {
+                std::lock_guard const lock{ mutex_ };
+                if (dctxs_.size() < max_idle_)
+                {
+                    dctxs_.push_back(ctx);
+                    return;
+                }
+            }
+
+            ZSTD_freeDCtx(ctx);
+        }
+
+        /**
+         * Return a buffer to the pool.
+         * @param buffer The buffer to return. Dropped if the pool is full.
+         */
+        void release(ranges::views::detail::zstd_buffer&& buffer)
+        {
+            std::lock_guard const lock{ mutex_ };
+            if (buffers_.size() < max_idle_ && buffer.capacity() > 0)
+            {
+                buffers_.push_back(std::move(buffer));
+            }
+        }
+
+        /**
+         * @return The number of idle compression contexts in the pool.
+         */
+        [[nodiscard]] auto idle_cctx_count() const -> size_t
+        {
+            std::lock_guard const lock{ mutex_ };
+            return cctxs_.size();
+        }
+
+        /**
+         * @return The number of idle decompression contexts in the pool.
+         */
+        [[nodiscard]] auto idle_dctx_count() const -> size_t
+        {
+            std::lock_guard const lock{ mutex_ };
+            return dctxs_.size();
+        }
+    };
+}
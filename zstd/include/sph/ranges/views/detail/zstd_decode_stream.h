@@ -0,0 +1,267 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <sph/ranges/views/detail/zstd_decompress.h>
+#include <sph/ranges/views/detail/zstd_read_ahead.h>
+
+namespace sph::ranges::views::detail
+{
+    /**
+     * Feeds a zstd compressed input range through a zstd_decompressor.
+     *
+     * Both the zstd_decode_view and zstd_decode_chunks_view iterators use
+     * this to stage the compressed input and fill the decompressor's out()
+     * buffer. They differ only in how they hand out the decompressed bytes.
+     *
+     * @tparam R The type of the range that holds a zstd compressed stream.
+     */
+    template<std::ranges::viewable_range R>
+        requires std::ranges::input_range<R> && std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<R>>>
+    class zstd_decode_stream
+    {
+    public:
+        using input_type = std::remove_cvref_t<std::ranges::range_value_t<R>>;
+
+        /**
+         * True if the compressed range sits in contiguous memory with a known
+         * length so zstd can read it in place instead of having it copied
+         * into the decompressor's input buffer.
+         */
+        static constexpr bool contiguous_input{
+            std::contiguous_iterator<std::ranges::const_iterator_t<R>>
+            && std::sized_sentinel_for<std::ranges::const_sentinel_t<R>, std::ranges::const_iterator_t<R>> };
+
+        /**
+         * True if zstd_decode_parameters::read_ahead can apply: the input
+         * gets copied into the decompressor's input buffer and the helper
+         * thread can take its own copy of the input iterator.
+         */
+        static constexpr bool can_read_ahead{ !contiguous_input && std::copyable<std::ranges::const_iterator_t<R>> };
+    private:
+        zstd_decompressor decompress_;
+        std::ranges::const_iterator_t<R> current_;
+        size_t current_pos_{ 0 };
+        std::ranges::const_sentinel_t<R> end_;
+        bool maybe_done_{ false };
+        std::optional<zstd_read_ahead> read_ahead_;
+    public:
+        /**
+         * Initialize a new instance of the zstd_decode_stream class.
+         * @param parameters The zstd decompression parameters.
+         * @param begin The start of the input range to decompress.
+         * @param end The end of the input range.
+         */
+        zstd_decode_stream(zstd_decode_parameters const& parameters, std::ranges::const_iterator_t<R> begin, std::ranges::const_sentinel_t<R> end)
+            : decompress_{
+                parameters,
+                contiguous_input || (can_read_ahead && parameters.read_ahead) ? 0 : zstd_staging_size(parameters.in_buffer_size, ZSTD_DStreamInSize()),
+                zstd_staging_size(parameters.out_buffer_size, ZSTD_DStreamOutSize()) }
+            , current_(std::move(begin)), end_(std::move(end))
+        {
+            if constexpr (can_read_ahead)
+            {
+                if (parameters.read_ahead)
+                {
+                    read_ahead_.emplace(zstd_staging_size(parameters.in_buffer_size, ZSTD_DStreamInSize()), [current{ current_ }, current_pos{ current_pos_ }, end{ end_ }](uint8_t* dst, size_t max_size) mutable -> size_t
+                        {
+                            return stage(current, current_pos, end, dst, max_size);
+                        });
+                }
+            }
+        }
+
+        /**
+         * Get the total decompressed size recorded in the frame headers of a
+         * contiguous compressed range.
+         * @param begin The start of the compressed range.
+         * @param end The end of the compressed range.
+         * @return The decompressed size in bytes; zero if any frame doesn't
+         * record its content size or the range isn't valid.
+         */
+        static auto content_size(std::ranges::const_iterator_t<R> begin, std::ranges::const_sentinel_t<R> end) -> size_t
+            requires contiguous_input
+        {
+            unsigned long long const ret{ ZSTD_findDecompressedSize(std::to_address(begin), static_cast<size_t>(end - begin) * sizeof(input_type)) };
+            return ret == ZSTD_CONTENTSIZE_UNKNOWN || ret == ZSTD_CONTENTSIZE_ERROR ? 0 : static_cast<size_t>(ret);
+        }
+
+        /**
+         * The decompressed output. Valid bytes run from pos to size.
+         */
+        [[nodiscard]] auto out() const -> ZSTD_outBuffer& { return decompress_.out(); }
+
+        /**
+         * @return True if the last decompression finished a zstd frame and
+         * flushed all of its output.
+         */
+        [[nodiscard]] auto maybe_done() const -> bool { return maybe_done_; }
+
+        /**
+         * @return The counters for the stream so far; zero without
+         * SPH_ZSTD_STATS.
+         */
+        [[nodiscard]] auto stats() const -> zstd_stats const& { return decompress_.recorder().stats(); }
+
+        /**
+         * Compare the provided stream position for equality.
+         * @param s The stream to compare against.
+         * @return True if the provided stream is at the same position as this one.
+         */
+        auto equals(const zstd_decode_stream& s) const noexcept -> bool
+        {
+            return current_ == s.current_ && decompress_.in().pos == s.decompress_.in().pos && decompress_.out().pos == s.decompress_.out().pos;
+        }
+
+        /**
+         * Performs decompression on the next chunk, loading the next chunk as
+         * needed, until some decompressed bytes are available.
+         *
+         * A call to zstd can legitimately produce nothing, for example when
+         * it consumes a skippable frame or the end of a frame, so this keeps
+         * going until it gets output or runs out of input.
+         *
+         * @param keep The number of bytes at the start of out() to keep ahead
+         * of the newly decompressed bytes.
+         * @return True if out() has new bytes; false if out of input.
+         */
+        auto load_next_out(size_t keep = 0) -> bool
+        {
+            auto const refilling{ decompress_.recorder().refilling() };
+            if constexpr (contiguous_input)
+            {
+                if (current_ != end_ && decompress_.in().size == 0)
+                {
+                    // nothing handed to zstd yet; if it all fits in out(), decompress it in one call
+                    size_t const size{ static_cast<size_t>(end_ - current_) * sizeof(input_type) };
+                    if (decompress_.decompress_once(reinterpret_cast<uint8_t const*>(std::to_address(current_)), size))
+                    {
+                        current_ = std::ranges::next(current_, end_);
+                        maybe_done_ = true;
+                        return decompress_.out().size > 0;
+                    }
+                }
+            }
+
+            while (true)
+            {
+                if (decompress_.in().pos >= decompress_.in().size)
+                {
+                    if (load_next_in() == false)
+                    {
+                        return false;
+                    }
+                }
+
+                maybe_done_ = decompress_(keep);
+                if (decompress_.out().size > keep)
+                {
+                    return true;
+                }
+            }
+        }
+
+    private:
+        /**
+         * Load the next chunk into the buffer the decompressor works on.
+         *
+         * For contiguous input, the decompressor's in() buffer gets
+         * pointed directly at the whole remaining input range. With read
+         * ahead, it gets pointed at the buffer the helper thread filled.
+         *
+         * @return True if not at end; false otherwise.
+         */
+        auto load_next_in() -> bool
+        {
+            auto const staging{ decompress_.recorder().staging() };
+            if constexpr (can_read_ahead)
+            {
+                if (read_ahead_)
+                {
+                    auto const in{ read_ahead_->next() };
+                    decompress_.in() = ZSTD_inBuffer{ in.data(), in.size(), 0 };
+                    return !in.empty();
+                }
+            }
+
+            if (current_ == end_)
+            {
+                return false;
+            }
+
+            if constexpr (contiguous_input)
+            {
+                size_t const remaining{ (static_cast<size_t>(end_ - current_) * sizeof(input_type)) - current_pos_ };
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                decompress_.in() = ZSTD_inBuffer{ reinterpret_cast<uint8_t const*>(std::to_address(current_)) + current_pos_, remaining, 0 };
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                current_ = std::ranges::next(current_, end_);
+                current_pos_ = 0;
+                return true;
+            }
+            else
+            {
+                size_t const size{ stage(current_, current_pos_, end_, decompress_.in_src(), decompress_.in_max_size()) };
+                decompress_.in().size = size;
+                decompress_.in().pos = 0;
+                return size > 0;
+            }
+        }
+
+        /**
+         * Copy the next of the input range into a buffer.
+         * @param current The input position. Gets advanced.
+         * @param current_pos The byte position within *current. Gets
+         * advanced.
+         * @param end The end of the input range.
+         * @param dst The buffer.
+         * @param max_size The size of the buffer.
+         * @return The number of bytes copied; zero at the end of the input.
+         */
+        static auto stage(std::ranges::const_iterator_t<R>& current, size_t& current_pos, std::ranges::const_sentinel_t<R> const& end, uint8_t* dst, size_t max_size) -> size_t
+        {
+            size_t i{ 0 };
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+            if constexpr (sizeof(input_type) == 1)
+            {
+                for (; i < max_size && current != end; ++i, ++current)
+                {
+                    dst[i] = static_cast<uint8_t>(*current);
+                }
+            }
+            else
+            {
+                while (i < max_size && current != end)
+                {
+                    input_type const value{ *current };
+                    size_t const count{ std::min(sizeof(input_type) - current_pos, max_size - i) };
+                    std::memcpy(dst + i, reinterpret_cast<uint8_t const*>(&value) + current_pos, count);
+                    i += count;
+                    current_pos += count;
+                    if (current_pos == sizeof(input_type))
+                    {
+                        ++current;
+                        current_pos = 0;
+                    }
+                }
+            }
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+            return i;
+        }
+    };
+}
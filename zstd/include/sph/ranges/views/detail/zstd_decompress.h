@@ -1,11 +1,160 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
 #include <format>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <stdexcept>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <zstd.h>
 #include <zstd_errors.h>
+#include <sph/ranges/views/detail/zstd_context_pool.h>
+#include <sph/ranges/views/detail/zstd_dictionary.h>
+#include <sph/ranges/views/detail/zstd_memory.h>
+#include <sph/ranges/views/detail/zstd_progress.h>
+#include <sph/ranges/views/detail/zstd_stats.h>
+namespace sph
+{
+    /**
+     * Parameters for zstd decompression.
+     */
+    struct zstd_decode_parameters
+    {
+        /**
+         * Size limit (in powers of 2) beyond which the decompressor will
+         * refuse to allocate a memory buffer in order to protect the host;
+         * zero for default. Valid values (typically): 11 through 30 (32-bit),
+         * 11 through 31 (64-bit). Out of range values will be clamped.
+         */
+        int window_log_max{ 0 };
+
+        /**
+         * The dictionary the stream was compressed with; none by default.
+         */
+        zstd_decode_dictionary dictionary{};
+
+        /**
+         * The pool to take the decompression context and buffers from; none
+         * by default, meaning each iterator allocates its own.
+         */
+        std::shared_ptr<zstd_context_pool> pool{};
+
+        /**
+         * The memory resource to allocate the decompression context, its
+         * workspace, and the buffers from; nullptr, the default, for the
+         * default heap. Must outlive the view and its iterators. Not used for
+         * anything taken from a pool.
+         */
+        std::pmr::memory_resource* memory_resource{ nullptr };
+
+        /**
+         * Caller-owned memory to build the decompression context and buffers
+         * in so decompression doesn't allocate; empty, the default, to have
+         * them allocated. Size it with zstd_decode_workspace_size() and align
+         * it to at least 8 bytes. Takes precedence over pool and
+         * memory_resource and must outlive the view's iterators. Only one
+         * iterator can use it at a time.
+         */
+        std::span<uint8_t> workspace{};
+
+        /**
+         * True to have a helper thread read the compressed input range ahead
+         * into a second input buffer while zstd decompresses the first; false,
+         * the default, to read it on the consumer's thread between calls to
+         * zstd. Worth it when the input range is expensive to read, say a
+         * transformed, joined, or file-backed view. Ignored for contiguous
+         * input, which zstd reads in place, and for input ranges with
+         * move-only iterators. The helper thread's buffers come from the
+         * default heap.
+         */
+        bool read_ahead{ false };
+
+        /**
+         * The size, in bytes, of the buffer a non-contiguous input range gets
+         * staged in for zstd, and of each read-ahead buffer; zero, the
+         * default, for ZSTD_DStreamInSize(), about 128 KiB. Contiguous input
+         * gets read in place. At least 1 KiB.
+         */
+        size_t in_buffer_size{ 0 };
+
+        /**
+         * The size, in bytes, of the buffer zstd decompresses into; zero, the
+         * default, for ZSTD_DStreamOutSize(), about 128 KiB. At least 1 KiB.
+         * Also the most each zstd_decode_chunks block holds.
+         *
+         * Smaller buffers save memory when many streams are open at once.
+         * Bigger ones spread the cost of each call to zstd over more bytes.
+         */
+        size_t out_buffer_size{ 0 };
+
+        /**
+         * True to skip verifying the frame checksums, saving a hash of every
+         * decompressed byte; false, the default, to verify them when
+         * present. For callers that already checksum at another layer.
+         */
+        bool ignore_checksum{ false };
+
+        /**
+         * Gets called with the stream's zstd_progress every
+         * progress_interval compressed bytes and when each frame ends;
+         * none, the default, for no reports. Runs on the thread doing the
+         * decompressing, between calls to zstd, so it can also throttle by
+         * blocking. An exception it throws comes out of the iterator.
+         */
+        zstd_progress_callback progress_callback{};
+
+        /**
+         * The number of compressed bytes between calls to
+         * progress_callback; zero, the default, for every 1 MiB. Checked
+         * after each call to zstd, so a report comes at the first call past
+         * each interval.
+         */
+        size_t progress_interval{ 0 };
+
+        /**
+         * Gets handed the stream's zstd_stats when the last copy of its
+         * iterator goes away; none by default. Runs on whichever thread that
+         * happens on and must not throw. Only called with SPH_ZSTD_STATS
+         * defined.
+         */
+        zstd_stats_callback stats_callback{};
+    };
+
+    /**
+     * Get the workspace size zstd decompression needs for the given maximum
+     * window size.
+     *
+     * Covers the decompression context, from ZSTD_estimateDStreamSize(),
+     * and the staging buffers.
+     *
+     * @param window_log_max The maximum window size (in powers of 2) to
+     * support; zero for the zstd default (typically 27). Clamped to the
+     * bounds the underlying zstd library reports.
+     * @param in_buffer_size The zstd_decode_parameters::in_buffer_size that
+     * will go with the workspace.
+     * @param out_buffer_size The zstd_decode_parameters::out_buffer_size
+     * that will go with the workspace.
+     * @return The number of bytes for zstd_decode_parameters::workspace.
+     */
+    inline auto zstd_decode_workspace_size(int window_log_max = 0, size_t in_buffer_size = 0, size_t out_buffer_size = 0) -> size_t
+    {
+        auto const [bounds_result, lower_bound, upper_bound]{ ZSTD_dParam_getBounds(ZSTD_d_windowLogMax) };
+        if (ZSTD_isError(bounds_result))
+        {
+            throw std::runtime_error(std::format("Failed to get zstd decompress context bounds: {}.", ZSTD_getErrorName(bounds_result)));
+        }
+
+        int const window_log{ window_log_max == 0 ? ZSTD_WINDOWLOG_LIMIT_DEFAULT : std::clamp(window_log_max, lower_bound, upper_bound) };
+        return ZSTD_estimateDStreamSize(static_cast<size_t>(1) << window_log)
+            + ranges::views::detail::zstd_staging_size(in_buffer_size, ZSTD_DStreamInSize())
+            + ranges::views::detail::zstd_staging_size(out_buffer_size, ZSTD_DStreamOutSize())
+            + alignof(std::max_align_t);
+    }
+}
+
 namespace sph::ranges::views::detail
 {
 	/**
@@ -14,28 +163,44 @@ namespace sph::ranges::views::detail
 	 */
 	class zstd_decompress_buf
 	{
-		size_t in_max_size_{ ZSTD_DStreamInSize() };
-		size_t out_max_size_{ ZSTD_DStreamOutSize() };
-		std::vector<uint8_t> buf_;
+		size_t in_max_size_;
+		size_t out_max_size_;
+		zstd_buffer buf_;
 		ZSTD_inBuffer in_buf_;
 		ZSTD_outBuffer out_buf_;
 	public:
-		zstd_decompress_buf()
-			: buf_(in_max_size_ + out_max_size_)
-			, in_buf_{ buf_.data(), in_max_size_, in_max_size_ }
+		zstd_decompress_buf() : zstd_decompress_buf(ZSTD_DStreamInSize()) {}
+		/**
+		 * Initialize a new instance of the zstd_decompress_buf class.
+		 * @param in_max_size The size of the input buffer. Zero if the input
+		 * buffer will always point at memory owned by someone else.
+		 * @param buf The storage to use for the buffers, typically from a
+		 * zstd_context_pool. Gets resized to fit.
+		 * @param out_max_size The size of the output buffer. Zero if the
+		 * output always goes to memory owned by someone else.
+		 */
+		explicit zstd_decompress_buf(size_t in_max_size, zstd_buffer buf = zstd_buffer{}, size_t out_max_size = ZSTD_DStreamOutSize())
+			: in_max_size_{ in_max_size }
+			, out_max_size_{ out_max_size }
+			, buf_(std::move(buf))
+			, in_buf_{}
+			, out_buf_{}
+	    {
+			buf_.resize(in_max_size_ + out_max_size_);
+			out_buf_ = ZSTD_outBuffer{ buf_.data(), out_max_size_, out_max_size_ }; // first so decompressed values are aligned
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
 #endif
-			, out_buf_{ buf_.data() + in_max_size_, out_max_size_, out_max_size_ }
+			in_buf_ = ZSTD_inBuffer{ buf_.data() + out_max_size_, in_max_size_, in_max_size_ };
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
-	    {}
-		zstd_decompress_buf(zstd_decompress_buf const&) = default;
+	    }
+		zstd_decompress_buf(zstd_decompress_buf const&) = delete;
 		zstd_decompress_buf(zstd_decompress_buf&&) = default;
 		~zstd_decompress_buf() = default;
-		zstd_decompress_buf& operator=(zstd_decompress_buf const&) = default;
+		zstd_decompress_buf& operator=(zstd_decompress_buf const&) = delete;
 		zstd_decompress_buf& operator=(zstd_decompress_buf&&) = default;
 		auto in() -> ZSTD_inBuffer& { return in_buf_; }
 		[[nodiscard]] auto in_pos() const -> size_t { return in_buf_.pos; }
@@ -43,6 +208,19 @@ namespace sph::ranges::views::detail
 		auto out() -> ZSTD_outBuffer& { return out_buf_; }
 		[[nodiscard]] auto out_pos() const -> size_t { return out_buf_.pos; }
 		[[nodiscard]] auto out_max_size() const -> size_t { return out_max_size_; }
+
+		/**
+		 * @param in_max_size The size of the input buffer.
+		 * @param out_max_size The size of the output buffer.
+		 * @return The number of bytes of storage the buffers need.
+		 */
+		static auto buffer_size(size_t in_max_size, size_t out_max_size = ZSTD_DStreamOutSize()) -> size_t { return in_max_size + out_max_size; }
+
+		/**
+		 * Give up the storage, typically to return it to a
+		 * zstd_context_pool. The buffers are unusable afterwards.
+		 */
+		auto release() -> zstd_buffer { return std::move(buf_); }
 	};
 
 	/**
@@ -61,54 +239,121 @@ namespace sph::ranges::views::detail
 		 */
 		struct zstd_data
 		{
-			ZSTD_DCtx* ctx{};
+            /**
+             * Returns the context to the pool it came from or frees it.
+             */
+            struct ctx_release
+            {
+                zstd_context_pool* pool{ nullptr };
+                void operator()(ZSTD_DCtx* ctx) const
+                {
+                    if (pool != nullptr)
+                    {
+                        pool->release(ctx);
+                    }
+                    else
+                    {
+                        ZSTD_freeDCtx(ctx); // a no-op for a context in a caller-supplied workspace
+                    }
+                }
+            };
+
+			std::shared_ptr<zstd_context_pool> pool;
+			std::unique_ptr<ZSTD_DCtx, ctx_release> ctx; // owned from the start so a later member failing to build doesn't leak it
 			zstd_decompress_buf buf{};
-            zstd_data() : ctx{ init_ctx(0) } {} // 0 sets the default window log max (27 typically)
+            zstd_decode_dictionary dictionary; // keeps the dictionary ctx references alive
+            zstd_stats_recorder stats;
+            zstd_progress_reporter progress;
             /**
              * Initialize a new instance of the zstd_data class.
-             * @param window_log_max Size limit (in powers of 2) beyond which
-             * the decompressor will refuse to allocate a memory buffer in
-             * order to protect the host; zero for default. Valid values
-             * (typically): 11 through 30 (32-bit), 11 through 31 (64-bit).
-             * Out of range values will be clamped.
+             * @param parameters The zstd decompression parameters.
+             * @param in_max_size The size of the input buffer. Zero if the
+             * input buffer will always point at memory owned by someone else.
+             * @param out_max_size The size of the output buffer. Zero if the
+             * output always goes to memory owned by someone else.
              */
-            explicit zstd_data(int window_log_max) : ctx{ init_ctx(window_log_max) } {}
+            zstd_data(zstd_decode_parameters const& parameters, size_t in_max_size, size_t out_max_size)
+                : pool{ parameters.workspace.empty() ? parameters.pool : nullptr }
+                , ctx{ init_ctx(parameters, zstd_decompress_buf::buffer_size(in_max_size, out_max_size), pool.get()) }
+                , buf{ in_max_size, init_buf(parameters, zstd_decompress_buf::buffer_size(in_max_size, out_max_size), pool.get()), out_max_size }
+                , dictionary{ parameters.dictionary }
+                , stats{ parameters }
+                , progress{ parameters } {}
 			zstd_data(zstd_data const&) = delete;
 			zstd_data(zstd_data&&) = default;
-			~zstd_data() { ZSTD_freeDCtx(ctx); }
+			~zstd_data()
+			{
+				ctx.reset(); // ahead of the dictionary it references
+				if (pool)
+				{
+					pool->release(buf.release());
+				}
+			}
 			auto operator=(zstd_data const&)->zstd_data & = delete;
 			auto operator=(zstd_data&&)->zstd_data & = default;
 		private:
-			static auto init_ctx(int window_log_max) -> ZSTD_DCtx*
+			static auto init_ctx(zstd_decode_parameters const& parameters, size_t buffer_size, zstd_context_pool* pool) -> std::unique_ptr<ZSTD_DCtx, ctx_release>
 			{
-				auto const ret{ ZSTD_createDCtx() };
+				std::unique_ptr<ZSTD_DCtx, ctx_release> ret{ nullptr, ctx_release{ pool } };
+				if (!parameters.workspace.empty())
+				{
+					auto const context_workspace{ zstd_split_workspace(parameters.workspace, buffer_size).first };
+					ret.reset(ZSTD_initStaticDCtx(context_workspace.data(), context_workspace.size()));
+				}
+				else
+				{
+					ret.reset(pool != nullptr ? pool->acquire_dctx() : zstd_create_dctx(parameters.memory_resource));
+				}
+
 				if (ret == nullptr)
 				{
 					throw std::runtime_error("Failed to create zstd decompress context.");
 				}
 
-                if (window_log_max != 0)
+                if (int const window_log_max{ parameters.window_log_max }; window_log_max != 0)
                 {
                     auto const [bounds_result, lower_bound, upper_bound]{ZSTD_dParam_getBounds(ZSTD_d_windowLogMax)};
                     if (ZSTD_isError(bounds_result))
                     {
-                        ZSTD_freeDCtx(ret);
                         throw std::runtime_error(std::format("Failed to get zstd decompress context bounds: {}.",
                                                              ZSTD_getErrorName(bounds_result)));
                     }
 
-                    ZSTD_DCtx_setParameter(ret, ZSTD_d_windowLogMax,
+                    ZSTD_DCtx_setParameter(ret.get(), ZSTD_d_windowLogMax,
                                            std::clamp(window_log_max, lower_bound, upper_bound));
                 }
 
+                if (parameters.ignore_checksum)
+                {
+                    ZSTD_DCtx_setParameter(ret.get(), ZSTD_d_forceIgnoreChecksum, ZSTD_d_ignoreChecksum);
+                }
+
+                if (parameters.dictionary)
+                {
+                    if (size_t const result{ ZSTD_DCtx_refDDict(ret.get(), parameters.dictionary.get()) }; ZSTD_isError(result))
+                    {
+                        throw std::runtime_error(std::format("Failed to set zstd decompression dictionary: {}.", ZSTD_getErrorName(result)));
+                    }
+                }
+
                 return ret;
             }
+
+			static auto init_buf(zstd_decode_parameters const& parameters, size_t buffer_size, zstd_context_pool* pool) -> zstd_buffer
+			{
+				if (!parameters.workspace.empty())
+				{
+					return zstd_buffer{ zstd_split_workspace(parameters.workspace, buffer_size).second };
+				}
+
+				return pool != nullptr ? pool->acquire_buffer() : zstd_buffer{ parameters.memory_resource };
+			}
 		};
 		std::shared_ptr<zstd_data> data_;
 		bool can_decompress_{ true };
 
 	public:
-		zstd_decompressor() : data_{ std::make_shared<zstd_data>() } {}
+		zstd_decompressor() : zstd_decompressor(zstd_decode_parameters{}, ZSTD_DStreamInSize()) {}
 		/**
 		 * Initialize a new instance of the zstd_decompressor class.
 		 * @param window_log_max Size limit (in powers of 2) beyond which
@@ -117,7 +362,21 @@ namespace sph::ranges::views::detail
 		 * (typically): 11 through 30 (32-bit), 11 through 31 (64-bit).
 		 * Out of range values will be clamped.
 		 */
-		explicit zstd_decompressor(int window_log_max) : data_{ std::make_shared<zstd_data>(window_log_max) } {}
+		explicit zstd_decompressor(int window_log_max) : zstd_decompressor(zstd_decode_parameters{ window_log_max, {} }, ZSTD_DStreamInSize()) {}
+		/**
+		 * Initialize a new instance of the zstd_decompressor class.
+		 * @param parameters The zstd decompression parameters.
+		 * @param in_max_size The size of the input buffer. Zero if in() will
+		 * always be pointed at memory owned by the caller.
+		 * @param out_max_size The size of the output buffer. Zero if the
+		 * output always goes to memory owned by the caller through
+		 * decompress_to().
+		 */
+		zstd_decompressor(zstd_decode_parameters const& parameters, size_t in_max_size, size_t out_max_size = ZSTD_DStreamOutSize())
+			: data_{ parameters.memory_resource == nullptr
+				? std::make_shared<zstd_data>(parameters, in_max_size, out_max_size)
+				: std::allocate_shared<zstd_data>(std::pmr::polymorphic_allocator<zstd_data>{ parameters.memory_resource }, parameters, in_max_size, out_max_size) }
+		{}
 		zstd_decompressor(zstd_decompressor const&o)
 			: data_{o.data_}
 			, can_decompress_{false} // only  one copy can decompress at a time
@@ -142,44 +401,185 @@ namespace sph::ranges::views::detail
 		[[nodiscard]] auto in_max_size() const -> size_t { return data_->buf.in_max_size(); }
 		[[nodiscard]] auto out() const -> ZSTD_outBuffer& { return data_->buf.out(); }
 		[[nodiscard]] auto out_max_size() const -> size_t { return data_->buf.out_max_size(); }
+		[[nodiscard]] auto recorder() const -> zstd_stats_recorder& { return data_->stats; }
 
 		/**
-		 * Runs a decompression on the input into the output. The output size will be set.
-		 *
-		 * Expects in() to have pos < size.
+		 * Decompress the whole input in one call, straight into the out()
+		 * buffer, if every frame records its content size and the total fits.
 		 *
-		 * Will set out() pos=0 and size to the number of bytes decompressed.
+		 * Must be called before any other decompression. Sets out() pos=0 and
+		 * size to the number of decompressed bytes.
 		 *
-		 * @return True if fully decoded and flushed; false if some decoding and flushing still remains.
+		 * @param src The compressed input. May hold multiple frames.
+		 * @param size The number of compressed bytes.
+		 * @return True if decompressed; false if the content size is unknown
+		 * or too big, in which case nothing happened.
 		 */
-		[[nodiscard]] auto operator()() const -> bool
+		[[nodiscard]] auto decompress_once(uint8_t const* src, size_t size) const -> bool
 		{
 			if (!can_decompress_)
 			{
 				throw std::logic_error("Only one copy of the zstd decompressor can decompress. You probably made a copy of the iterator and tried to use it. Moving the iterator is fine.");
 			}
+
+			if (unsigned long long const content_size{ ZSTD_findDecompressedSize(src, size) };
+				content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size == ZSTD_CONTENTSIZE_ERROR || content_size > data_->buf.out_max_size())
+			{
+				return false;
+			}
+
 			auto &o{ data_->buf.out() };
-			auto &i{ data_->buf.in() };
+			o.size = decompress_to(src, size, static_cast<uint8_t*>(o.dst), data_->buf.out_max_size());
 			o.pos = 0;
-			o.size = data_->buf.out_max_size();
+			return true;
+		}
 
-			size_t const ret{ ZSTD_decompressStream(data_->ctx, &o, &i) };
+		/**
+		 * Decompress the whole input in one call straight into memory owned
+		 * by the caller, bypassing out().
+		 *
+		 * Must be called before any other decompression.
+		 *
+		 * @param src The compressed input. May hold multiple frames.
+		 * @param size The number of compressed bytes.
+		 * @param dst Where to put the decompressed bytes.
+		 * @param capacity The number of bytes available at dst. Throws
+		 * std::invalid_argument if the decompressed bytes don't fit.
+		 * @return The number of decompressed bytes.
+		 */
+		auto decompress_to(uint8_t const* src, size_t size, uint8_t* dst, size_t capacity) const -> size_t
+		{
+			if (!can_decompress_)
+			{
+				throw std::logic_error("Only one copy of the zstd decompressor can decompress. You probably made a copy of the iterator and tried to use it. Moving the iterator is fine.");
+			}
+
+			auto const call{ data_->stats.begin_zstd(0, 0) };
+			size_t const ret{ ZSTD_decompressDCtx(data_->ctx.get(), dst, capacity, src, size) };
 			if (ZSTD_isError(ret))
 			{
-				ZSTD_ErrorCode const err{ ZSTD_getErrorCode(ret) };
-				ZSTD_DCtx_reset(data_->ctx, ZSTD_reset_session_only);
-				if (err == ZSTD_error_memory_allocation)
-				{
-					// I think memory allocation issues is the only error that can happen that should be a runtime_error here.
-					throw std::runtime_error(std::format("zstd failed decompression: {}.", ZSTD_getErrorString(err)));
-				}
+				throw_error(ret);
+			}
 
-				throw std::invalid_argument(std::format("zstd failed decompression: {}.", ZSTD_getErrorString(err)));
+			data_->stats.end_zstd(call, size, ret);
+			if (data_->progress.enabled())
+			{
+				data_->progress.record(size, ret, true, [] { return ZSTD_frameProgression{}; });
 			}
 
+			return ret;
+		}
+
+		/**
+		 * Decompress the data in the in() buffer straight into memory owned
+		 * by the caller, bypassing out().
+		 *
+		 * @param out Where to put the decompressed bytes. Decompressed bytes
+		 * get written starting at pos, which gets advanced past them.
+		 * @return True if fully decoded and flushed; false if some decoding
+		 * and flushing still remains.
+		 */
+		[[nodiscard]] auto decompress_to(ZSTD_outBuffer& out) const -> bool
+		{
+			if (!can_decompress_)
+			{
+				throw std::logic_error("Only one copy of the zstd decompressor can decompress. You probably made a copy of the iterator and tried to use it. Moving the iterator is fine.");
+			}
+
+			size_t const in_pos{ data_->buf.in().pos };
+			size_t const out_pos{ out.pos };
+			auto const call{ data_->stats.begin_zstd(in_pos, out_pos) };
+			size_t const ret{ ZSTD_decompressStream(data_->ctx.get(), &out, &data_->buf.in()) };
+			if (ZSTD_isError(ret))
+			{
+				throw_error(ret);
+			}
+
+			data_->stats.end_zstd(call, data_->buf.in().pos, out.pos);
+			if (data_->progress.enabled())
+			{
+				data_->progress.record(data_->buf.in().pos - in_pos, out.pos - out_pos, ret == 0, [] { return ZSTD_frameProgression{}; });
+			}
+
+			return ret == 0;
+		}
+
+		/**
+		 * Runs a decompression on the input into the output. The output size will be set.
+		 *
+		 * Expects in() to have pos < size.
+		 *
+		 * Will set out() pos=0 and size to the number of bytes decompressed
+		 * plus the number of kept bytes.
+		 *
+		 * @param keep The number of bytes already at the start of out() to
+		 * keep. Decompressed bytes get appended after them.
+		 * @return True if fully decoded and flushed; false if some decoding and flushing still remains.
+		 */
+		[[nodiscard]] auto operator()(size_t keep = 0) const -> bool
+		{
+			auto &o{ data_->buf.out() };
+			o.pos = keep;
+			o.size = data_->buf.out_max_size();
+			bool const ret{ decompress_to(o) };
 			o.size = o.pos;
 			o.pos = 0;
-			return ret == 0;
+			return ret;
+		}
+
+	private:
+		/**
+		 * Reset the session and throw the exception for the given zstd error.
+		 * @param result The failed zstd result.
+		 */
+		[[noreturn]] void throw_error(size_t result) const
+		{
+			ZSTD_ErrorCode const err{ ZSTD_getErrorCode(result) };
+			ZSTD_DCtx_reset(data_->ctx.get(), ZSTD_reset_session_only);
+			if (err == ZSTD_error_memory_allocation)
+			{
+				// I think memory allocation issues is the only error that can happen that should be a runtime_error here.
+				throw std::runtime_error(std::format("zstd failed decompression: {}.", ZSTD_getErrorString(err)));
+			}
+
+			throw std::invalid_argument(std::format("zstd failed decompression: {}.", ZSTD_getErrorString(err)));
 		}
 	};
+
+	/**
+	 * Enforce window_log_max on frames about to be decompressed in one call,
+	 * which zstd doesn't check it for.
+	 *
+	 * Will throw std::invalid_argument if a frame needs a bigger window.
+	 *
+	 * @param parameters The zstd decompression parameters.
+	 * @param frames Whole compressed frames.
+	 * @param view The name of the view, for the error message.
+	 */
+	inline void zstd_check_window(zstd_decode_parameters const& parameters, std::span<uint8_t const> frames, std::string_view view)
+	{
+		if (parameters.window_log_max == 0)
+		{
+			return;
+		}
+
+		auto const bounds{ ZSTD_dParam_getBounds(ZSTD_d_windowLogMax) };
+		unsigned long long const max_window{ 1ULL << std::clamp(parameters.window_log_max, bounds.lowerBound, bounds.upperBound) };
+		while (!frames.empty())
+		{
+			ZSTD_frameHeader header{};
+			if (ZSTD_getFrameHeader(&header, frames.data(), frames.size()) == 0 && header.frameType == ZSTD_frame && header.windowSize > max_window)
+			{
+				throw std::invalid_argument(std::format("{}: Frame window of {} bytes exceeds window_log_max.", view, header.windowSize));
+			}
+
+			size_t const frame_size{ ZSTD_findFrameCompressedSize(frames.data(), frames.size()) };
+			if (ZSTD_isError(frame_size))
+			{
+				return; // decompression reports the damage
+			}
+
+			frames = frames.subspan(frame_size);
+		}
+	}
 }
@@ -0,0 +1,156 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <zdict.h>
+#include <zstd.h>
+#include <zstd_errors.h>
+namespace sph
+{
+    /**
+     * A zstd dictionary digested for compression.
+     *
+     * Digesting a dictionary is expensive compared to compressing a small
+     * record, so do it once and hand the result to as many zstd_encode views
+     * as needed. Copies share the same digested dictionary and it is safe to
+     * use from multiple threads at once.
+     *
+     * A default constructed zstd_encode_dictionary holds no dictionary.
+     */
+    class zstd_encode_dictionary
+    {
+        std::shared_ptr<ZSTD_CDict> dict_;
+    public:
+        zstd_encode_dictionary() = default;
+
+        /**
+         * Initialize a new instance of the zstd_encode_dictionary class.
+         * @param dictionary The dictionary content, typically from
+         * zstd_train_dictionary(). Gets copied.
+         * @param compression_level The compression level to digest the
+         * dictionary for. Compressing with the dictionary uses this level
+         * instead of the level in the zstd_encode_parameters. Clamped by
+         * ZSTD_minCLevel() and ZSTD_maxCLevel().
+         */
+        explicit zstd_encode_dictionary(std::span<uint8_t const> dictionary, int compression_level = 0)
+            : dict_{ ZSTD_createCDict(dictionary.data(), dictionary.size(), std::clamp(compression_level, ZSTD_minCLevel(), ZSTD_maxCLevel())), ZSTD_freeCDict }
+        {
+            if (dict_ == nullptr)
+            {
+                throw std::runtime_error("Failed to create zstd compression dictionary.");
+            }
+        }
+
+        /**
+         * @return The digested dictionary; nullptr if none.
+         */
+        [[nodiscard]] auto get() const -> ZSTD_CDict const* { return dict_.get(); }
+
+        /**
+         * @return The dictionary ID written into frames compressed with this
+         * dictionary; zero if none.
+         */
+        [[nodiscard]] auto id() const -> unsigned { return dict_ == nullptr ? 0 : ZSTD_getDictID_fromCDict(dict_.get()); }
+
+        explicit operator bool() const { return dict_ != nullptr; }
+    };
+
+    /**
+     * A zstd dictionary digested for decompression.
+     *
+     * Copies share the same digested dictionary and it is safe to use from
+     * multiple threads at once.
+     *
+     * A default constructed zstd_decode_dictionary holds no dictionary.
+     */
+    class zstd_decode_dictionary
+    {
+        std::shared_ptr<ZSTD_DDict> dict_;
+    public:
+        zstd_decode_dictionary() = default;
+
+        /**
+         * Initialize a new instance of the zstd_decode_dictionary class.
+         * @param dictionary The dictionary content the stream was compressed
+         * with. Gets copied.
+         */
+        explicit zstd_decode_dictionary(std::span<uint8_t const> dictionary)
+            : dict_{ ZSTD_createDDict(dictionary.data(), dictionary.size()), ZSTD_freeDDict }
+        {
+            if (dict_ == nullptr)
+            {
+                throw std::runtime_error("Failed to create zstd decompression dictionary.");
+            }
+        }
+
+        /**
+         * @return The digested dictionary; nullptr if none.
+         */
+        [[nodiscard]] auto get() const -> ZSTD_DDict const* { return dict_.get(); }
+
+        /**
+         * @return The dictionary ID of this dictionary; zero if none.
+         */
+        [[nodiscard]] auto id() const -> unsigned { return dict_ == nullptr ? 0 : ZSTD_getDictID_fromDDict(dict_.get()); }
+
+        explicit operator bool() const { return dict_ != nullptr; }
+    };
+
+    /**
+     * Train a zstd dictionary from a set of sample records.
+     *
+     * Each sample is a range of standard layout values that gets treated as
+     * its bytes. The samples should look like the records that will get
+     * compressed with the dictionary. Zstd wants a lot of samples, typically
+     * around 100 times the dictionary capacity in total.
+     *
+     * @param samples A range of sample ranges.
+     * @param dictionary_capacity The maximum size of the dictionary in
+     * bytes. The zstd command line tool defaults to 112640.
+     * @return The dictionary content. Use it to construct a
+     * zstd_encode_dictionary and a zstd_decode_dictionary.
+     */
+    template<std::ranges::input_range S>
+        requires std::ranges::input_range<std::ranges::range_reference_t<S>>
+            && std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<std::ranges::range_reference_t<S>>>>
+    auto zstd_train_dictionary(S&& samples, size_t dictionary_capacity = 112'640) -> std::vector<uint8_t>
+    {
+        using sample_value_type = std::remove_cvref_t<std::ranges::range_value_t<std::ranges::range_reference_t<S>>>;
+        std::vector<uint8_t> sample_buffer;
+        std::vector<size_t> sample_sizes;
+        for (auto&& sample : samples)
+        {
+            size_t const start{ sample_buffer.size() };
+            for (sample_value_type const value : sample)
+            {
+                auto const* const value_bytes{ reinterpret_cast<uint8_t const*>(&value) };
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                sample_buffer.insert(sample_buffer.end(), value_bytes, value_bytes + sizeof(sample_value_type));
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+            }
+
+            sample_sizes.push_back(sample_buffer.size() - start);
+        }
+
+        std::vector<uint8_t> ret(dictionary_capacity);
+        size_t const size{ ZDICT_trainFromBuffer(ret.data(), ret.size(), sample_buffer.data(), sample_sizes.data(), static_cast<unsigned>(sample_sizes.size())) };
+        if (ZDICT_isError(size))
+        {
+            throw std::invalid_argument(std::format("zstd failed to train dictionary: {}.", ZDICT_getErrorName(size)));
+        }
+
+        ret.resize(size);
+        return ret;
+    }
+}
@@ -0,0 +1,235 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#ifndef ZSTD_STATIC_LINKING_ONLY
+#define ZSTD_STATIC_LINKING_ONLY // for ZSTD_customMem and ZSTD_createCCtx_advanced()
+#endif
+#include <zstd.h>
+namespace sph::ranges::views::detail
+{
+    /**
+     * Zstd frees memory without saying how much, but a
+     * std::pmr::memory_resource needs to know. So each allocation carries
+     * its size in a header this big, keeping the memory zstd sees aligned.
+     */
+    inline constexpr size_t zstd_allocation_header_size{ alignof(std::max_align_t) };
+
+    /**
+     * Get the zstd custom memory functions that route zstd's internal
+     * allocations to the given memory resource.
+     * @param resource The memory resource to allocate from. Must outlive
+     * every zstd object created with the returned functions.
+     * @return The zstd custom memory functions.
+     */
+    inline auto zstd_custom_mem(std::pmr::memory_resource* resource) -> ZSTD_customMem
+    {
+        return ZSTD_customMem{
+            [](void* opaque, size_t size) -> void*
+            {
+                try
+                {
+                    auto* const ret{ static_cast<std::byte*>(static_cast<std::pmr::memory_resource*>(opaque)->allocate(size + zstd_allocation_header_size, alignof(std::max_align_t))) };
+                    std::memcpy(ret, &size, sizeof(size));
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                    return ret + zstd_allocation_header_size;
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                }
+                catch (std::bad_alloc const&)
+                {
+                    return nullptr; // zstd is C; it reports failure with nullptr
+                }
+            },
+            [](void* opaque, void* address) -> void
+            {
+                if (address == nullptr)
+                {
+                    return;
+                }
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                auto* const allocation{ static_cast<std::byte*>(address) - zstd_allocation_header_size };
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                size_t size{ 0 };
+                std::memcpy(&size, allocation, sizeof(size));
+                static_cast<std::pmr::memory_resource*>(opaque)->deallocate(allocation, size + zstd_allocation_header_size, alignof(std::max_align_t));
+            },
+            resource
+        };
+    }
+
+    /**
+     * Create a zstd compression context.
+     * @param resource The memory resource for the context's workspace;
+     * nullptr for zstd's default allocator.
+     * @return The new context; nullptr on failure.
+     */
+    inline auto zstd_create_cctx(std::pmr::memory_resource* resource) -> ZSTD_CCtx*
+    {
+        return resource == nullptr ? ZSTD_createCCtx() : ZSTD_createCCtx_advanced(zstd_custom_mem(resource));
+    }
+
+    /**
+     * Create a zstd decompression context.
+     * @param resource The memory resource for the context's workspace;
+     * nullptr for zstd's default allocator.
+     * @return The new context; nullptr on failure.
+     */
+    inline auto zstd_create_dctx(std::pmr::memory_resource* resource) -> ZSTD_DCtx*
+    {
+        return resource == nullptr ? ZSTD_createDCtx() : ZSTD_createDCtx_advanced(zstd_custom_mem(resource));
+    }
+
+    /**
+     * @param resource A memory resource; possibly nullptr.
+     * @return The given memory resource or, if nullptr, the default one.
+     */
+    inline auto zstd_memory_resource_or_default(std::pmr::memory_resource* resource) -> std::pmr::memory_resource*
+    {
+        return resource == nullptr ? std::pmr::get_default_resource() : resource;
+    }
+
+    /**
+     * The smallest staging buffer a view will use, whatever size gets asked
+     * for.
+     */
+    inline constexpr size_t zstd_min_staging_size{ 1024 };
+
+    /**
+     * Get the size of a staging buffer.
+     * @param requested The requested size; zero for the zstd default.
+     * @param zstd_default The size zstd recommends, such as
+     * ZSTD_CStreamInSize().
+     * @return The size to use, at least zstd_min_staging_size.
+     */
+    inline auto zstd_staging_size(size_t requested, size_t zstd_default) -> size_t
+    {
+        return requested == 0 ? zstd_default : std::max(requested, zstd_min_staging_size);
+    }
+
+    /**
+     * Split a caller-supplied workspace into the part for a static zstd
+     * context and the part for the buffers.
+     * @param workspace The caller-supplied workspace.
+     * @param buffer_size The number of bytes the buffers need.
+     * @return The context part, still aligned like the workspace, followed
+     * by the buffer part, aligned to alignof(std::max_align_t) relative to the
+     * workspace.
+     */
+    inline auto zstd_split_workspace(std::span<uint8_t> workspace, size_t buffer_size) -> std::pair<std::span<uint8_t>, std::span<uint8_t>>
+    {
+        if (workspace.size() < buffer_size)
+        {
+            throw std::invalid_argument(std::format("zstd workspace too small. Required more than {} bytes, received {}.", buffer_size, workspace.size()));
+        }
+
+        size_t const context_size{ (workspace.size() - buffer_size) & ~(alignof(std::max_align_t) - 1) };
+        return { workspace.first(context_size), workspace.subspan(context_size) };
+    }
+
+    /**
+     * An uninitialized byte buffer for zstd to work in, either from a memory
+     * resource or borrowed from the caller.
+     *
+     * Unlike a std::pmr::vector, resizing doesn't zero the bytes. Zstd
+     * overwrites them anyway and zeroing a few hundred KiB per iterator
+     * shows up when compressing small messages.
+     */
+    class zstd_buffer
+    {
+        std::pmr::memory_resource* resource_;
+        uint8_t* data_{ nullptr };
+        size_t size_{ 0 };
+        size_t capacity_{ 0 };
+    public:
+        /**
+         * Initialize a new, empty, instance of the zstd_buffer class.
+         * @param resource The memory resource to allocate from; nullptr for
+         * the default one.
+         */
+        explicit zstd_buffer(std::pmr::memory_resource* resource = nullptr) : resource_{ zstd_memory_resource_or_default(resource) } {}
+
+        /**
+         * Initialize a new instance of the zstd_buffer class over memory
+         * owned by the caller. It cannot grow beyond that memory.
+         * @param storage The memory to use.
+         */
+        explicit zstd_buffer(std::span<uint8_t> storage) : resource_{ nullptr }, data_{ storage.data() }, size_{ storage.size() }, capacity_{ storage.size() } {}
+        zstd_buffer(zstd_buffer const&) = delete;
+        zstd_buffer(zstd_buffer&& o) noexcept
+            : resource_{ o.resource_ }
+            , data_{ std::exchange(o.data_, nullptr) }
+            , size_{ std::exchange(o.size_, 0) }
+            , capacity_{ std::exchange(o.capacity_, 0) }
+        {}
+        ~zstd_buffer() { deallocate(); }
+        auto operator=(zstd_buffer const&) -> zstd_buffer& = delete;
+        auto operator=(zstd_buffer&& o) noexcept -> zstd_buffer&
+        {
+            if (&o != this)
+            {
+                deallocate();
+                resource_ = o.resource_;
+                data_ = std::exchange(o.data_, nullptr);
+                size_ = std::exchange(o.size_, 0);
+                capacity_ = std::exchange(o.capacity_, 0);
+            }
+
+            return *this;
+        }
+
+        [[nodiscard]] auto data() const -> uint8_t* { return data_; }
+        [[nodiscard]] auto size() const -> size_t { return size_; }
+        [[nodiscard]] auto capacity() const -> size_t { return capacity_; }
+
+        /**
+         * Resize the buffer. The contents are unspecified afterwards.
+         * @param size The new size in bytes.
+         */
+        void resize(size_t size)
+        {
+            if (size > capacity_)
+            {
+                if (resource_ == nullptr)
+                {
+                    throw std::invalid_argument(std::format("zstd workspace too small. Required {} bytes for buffers, received {}.", size, capacity_));
+                }
+
+                deallocate();
+                data_ = static_cast<uint8_t*>(resource_->allocate(size, alignof(std::max_align_t)));
+                capacity_ = size;
+            }
+
+            size_ = size;
+        }
+
+    private:
+        void deallocate()
+        {
+            if (data_ != nullptr && resource_ != nullptr)
+            {
+                resource_->deallocate(data_, capacity_, alignof(std::max_align_t));
+                data_ = nullptr;
+                size_ = 0;
+                capacity_ = 0;
+            }
+        }
+    };
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <sph/ranges/views/detail/zstd_memory.h>
+
+namespace sph
+{
+    /**
+     * How far a zstd stream has gotten, handed to a progress_callback.
+     */
+    struct zstd_progress
+    {
+        /**
+         * The bytes zstd has consumed so far: uncompressed when encoding,
+         * compressed when decoding.
+         */
+        uint64_t consumed{ 0 };
+
+        /**
+         * The bytes zstd has produced so far: compressed when encoding,
+         * decompressed when decoding.
+         */
+        uint64_t produced{ 0 };
+
+        /**
+         * From ZSTD_getFrameProgression() for the current frame when
+         * encoding. With workers, shows how much input the workers hold and
+         * how many are busy. All zeros when decoding.
+         */
+        ZSTD_frameProgression frame{};
+    };
+
+    /**
+     * Gets handed the progress of a stream every progress_interval input
+     * bytes.
+     */
+    using zstd_progress_callback = std::function<void(zstd_progress const&)>;
+}
+
+namespace sph::ranges::views::detail
+{
+    /**
+     * Calls the progress_callback of the parameters, if any, every
+     * progress_interval input bytes and at the end of each frame.
+     */
+    class zstd_progress_reporter
+    {
+        zstd_progress_callback callback_;
+        uint64_t interval_;
+        uint64_t next_;
+        zstd_progress progress_{};
+    public:
+        /**
+         * The input bytes between reports if progress_interval is zero.
+         */
+        static constexpr uint64_t default_interval{ static_cast<uint64_t>(1024) * 1024 };
+
+        /**
+         * Initialize a new instance of the zstd_progress_reporter class.
+         * @tparam P zstd_encode_parameters or zstd_decode_parameters.
+         * @param parameters Provides the progress_callback and
+         * progress_interval.
+         */
+        template<typename P>
+        explicit zstd_progress_reporter(P const& parameters)
+            : callback_{ parameters.progress_callback }
+            , interval_{ parameters.progress_interval == 0 ? default_interval : parameters.progress_interval }
+            , next_{ interval_ } {}
+
+        /**
+         * @return True if there is a callback to report to. Check before
+         * calling record() so streams without one pay for a single branch.
+         */
+        [[nodiscard]] auto enabled() const -> bool { return static_cast<bool>(callback_); }
+
+        /**
+         * Account for a call to zstd, reporting if it crossed the next
+         * interval or finished a frame.
+         * @tparam F The type of the frame progression getter.
+         * @param consumed The bytes zstd consumed in the call.
+         * @param produced The bytes zstd produced in the call.
+         * @param frame_complete True if the call finished a frame.
+         * @param frame Gets the frame progression; only called when reporting.
+         */
+        template<typename F>
+        void record(size_t consumed, size_t produced, bool frame_complete, F&& frame)
+        {
+            progress_.consumed += consumed;
+            progress_.produced += produced;
+            if (progress_.consumed < next_ && !frame_complete)
+            {
+                return;
+            }
+
+            next_ = progress_.consumed + interval_;
+            progress_.frame = std::forward<F>(frame)();
+            callback_(progress_);
+        }
+    };
+}
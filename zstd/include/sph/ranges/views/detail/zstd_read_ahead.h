@@ -0,0 +1,138 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sph::ranges::views::detail
+{
+    /**
+     * Stages compressed input on a helper thread so it is ready by the time
+     * zstd wants it.
+     *
+     * There are two input buffers. zstd works on one while the helper thread
+     * fills the other, so reading an expensive input range overlaps with
+     * decompression instead of taking turns with it.
+     *
+     * Copies share the helper thread and the buffers. The helper thread stops
+     * and gets joined when the last copy goes away.
+     */
+    class zstd_read_ahead
+    {
+        struct state
+        {
+            std::mutex mutex;
+            std::condition_variable_any ready_changed;
+            std::vector<uint8_t> staged;   // the helper thread fills this one while ready is false
+            std::vector<uint8_t> in;       // zstd works on this one
+            size_t staged_size{ 0 };
+            bool ready{ false };
+            std::exception_ptr error;
+            std::jthread helper;
+
+            explicit state(size_t in_max_size) : staged(in_max_size), in(in_max_size) {}
+        };
+
+        std::shared_ptr<state> state_;
+    public:
+        /**
+         * Initialize a new instance of the zstd_read_ahead class, starting
+         * the helper thread.
+         * @tparam F The type of the staging function.
+         * @param in_max_size The size of each input buffer.
+         * @param stage Called on the helper thread with a buffer and its
+         * size to copy the next of the input into it. Returns the number of
+         * bytes copied; zero at the end of the input.
+         */
+        template<typename F>
+        zstd_read_ahead(size_t in_max_size, F stage) : state_{ std::make_shared<state>(in_max_size) }
+        {
+            state_->helper = std::jthread(run<F>, std::ref(*state_), std::move(stage));
+        }
+
+        /**
+         * Take the next buffer of input, waiting for the helper thread as
+         * needed, and let the helper thread start on the one after.
+         *
+         * Rethrows whatever exception the input range threw on the helper
+         * thread.
+         *
+         * @return The input; valid until the next call. Empty at the end of
+         * the input.
+         */
+        auto next() -> std::span<uint8_t const>
+        {
+            auto& s{ *state_ };
+            std::unique_lock lock{ s.mutex };
+            s.ready_changed.wait(lock, [&s] { return s.ready; });
+            if (s.error)
+            {
+                std::rethrow_exception(s.error);
+            }
+
+            if (s.staged_size == 0)
+            {
+                return {};
+            }
+
+            std::swap(s.staged, s.in);
+            size_t const size{ std::exchange(s.staged_size, 0) };
+            s.ready = false;
+            s.ready_changed.notify_all();
+            return std::span{ s.in }.first(size);
+        }
+
+    private:
+        /**
+         * Fill the staged buffer each time zstd takes the last one. Runs on
+         * the helper thread.
+         * @param stop Set when the last copy goes away.
+         * @param s The shared state.
+         * @param stage The staging function.
+         */
+        template<typename F>
+        static void run(std::stop_token const& stop, state& s, F stage)
+        {
+            try
+            {
+                while (true)
+                {
+                    {
+                        std::unique_lock lock{ s.mutex };
+                        if (!s.ready_changed.wait(lock, stop, [&s] { return !s.ready; }))
+                        {
+                            return;
+                        }
+                    }
+
+                    size_t const size{ stage(s.staged.data(), s.staged.size()) };
+                    {
+                        std::scoped_lock const lock{ s.mutex };
+                        s.staged_size = size;
+                        s.ready = true;
+                    }
+
+                    s.ready_changed.notify_all();
+                    if (size == 0)
+                    {
+                        return;
+                    }
+                }
+            }
+            catch (...)
+            {
+                std::scoped_lock const lock{ s.mutex };
+                s.error = std::current_exception();
+                s.staged_size = 0;
+                s.ready = true;
+                s.ready_changed.notify_all();
+            }
+        }
+    };
+}
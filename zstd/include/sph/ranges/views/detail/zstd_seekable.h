@@ -0,0 +1,235 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include <zstd.h>
+
+namespace sph::ranges::views::detail
+{
+    /**
+     * The magic number at the very end of a stream in the zstd contrib
+     * seekable format.
+     */
+    inline constexpr uint32_t zstd_seekable_magic{ 0x8F92EAB1 };
+
+    /**
+     * The skippable frame magic number the seek table frame uses.
+     */
+    inline constexpr uint32_t zstd_seek_table_magic{ 0x184D2A5E };
+
+    /**
+     * The skippable frame magic number padding frames use.
+     */
+    inline constexpr uint32_t zstd_skippable_magic{ 0x184D2A50 };
+
+    /**
+     * The size of a skippable frame header: the magic number and the size.
+     */
+    inline constexpr size_t zstd_skippable_header_size{ 8 };
+
+    /**
+     * The size of the seek table footer: the number of frames, the
+     * descriptor, and the seekable magic number.
+     */
+    inline constexpr size_t zstd_seek_table_footer_size{ 9 };
+
+    /**
+     * The largest number of decompressed bytes the seekable format allows
+     * in a frame.
+     */
+    inline constexpr size_t zstd_seekable_max_frame_size{ 0x40000000 };
+
+    /**
+     * The largest number of frames the seekable format allows.
+     */
+    inline constexpr size_t zstd_seekable_max_frames{ 0x8000000 };
+
+    /**
+     * A seek table entry as written by the encoder.
+     */
+    struct zstd_seekable_entry
+    {
+        uint32_t compressed_size;
+        uint32_t decompressed_size;
+    };
+
+    /**
+     * A frame of a seekable stream as found by the decoder.
+     */
+    struct zstd_seekable_frame
+    {
+        size_t compressed_offset;
+        size_t compressed_size;
+        size_t decompressed_offset;
+        size_t decompressed_size;
+    };
+
+    /**
+     * Append a little-endian 32-bit value.
+     * @param out Where to append the value.
+     * @param value The value to append.
+     */
+    inline void zstd_put_le32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            value = std::byteswap(value);
+        }
+
+        std::array<uint8_t, sizeof(value)> bytes{};
+        std::memcpy(bytes.data(), &value, sizeof(value));
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+
+    /**
+     * Read a little-endian 32-bit value.
+     * @param bytes The bytes to read. Must hold at least 4.
+     * @return The value.
+     */
+    inline auto zstd_get_le32(std::span<uint8_t const> bytes) -> uint32_t
+    {
+        uint32_t ret{ 0 };
+        std::memcpy(&ret, bytes.data(), sizeof(ret));
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            ret = std::byteswap(ret);
+        }
+
+        return ret;
+    }
+
+    /**
+     * Build the seek table that ends a stream in the zstd contrib seekable
+     * format.
+     *
+     * The seek table has to be last, so if the stream must come out to a
+     * multiple of some value size, a padding skippable frame goes ahead of
+     * the seek table rather than after it.
+     *
+     * @param entries The compressed and decompressed size of each frame, in
+     * order.
+     * @param alignment The stream, frames plus seek table, gets padded to a
+     * multiple of this many bytes.
+     * @return The padding frame, if any, followed by the seek table frame.
+     */
+    inline auto zstd_seek_table(std::span<zstd_seekable_entry const> entries, size_t alignment) -> std::vector<uint8_t>
+    {
+        size_t compressed_size{ 0 };
+        for (auto const& entry : entries)
+        {
+            compressed_size += entry.compressed_size;
+        }
+
+        size_t const table_size{ (entries.size() * sizeof(zstd_seekable_entry)) + zstd_seek_table_footer_size };
+        std::vector<uint8_t> ret;
+        if (size_t const padding{ (alignment - ((compressed_size + zstd_skippable_header_size + table_size) % alignment)) % alignment }; padding > 0)
+        {
+            size_t padding_size{ padding };
+            while (padding_size < zstd_skippable_header_size)
+            {
+                padding_size += alignment;
+            }
+
+            zstd_put_le32(ret, zstd_skippable_magic);
+            zstd_put_le32(ret, static_cast<uint32_t>(padding_size - zstd_skippable_header_size));
+            ret.resize(padding_size, static_cast<uint8_t>(0xCD));
+        }
+
+        ret.reserve(ret.size() + zstd_skippable_header_size + table_size);
+        zstd_put_le32(ret, zstd_seek_table_magic);
+        zstd_put_le32(ret, static_cast<uint32_t>(table_size));
+        for (auto const& entry : entries)
+        {
+            zstd_put_le32(ret, entry.compressed_size);
+            zstd_put_le32(ret, entry.decompressed_size);
+        }
+
+        zstd_put_le32(ret, static_cast<uint32_t>(entries.size()));
+        ret.push_back(0); // descriptor: no checksums, zstd frames carry their own
+        zstd_put_le32(ret, zstd_seekable_magic);
+        return ret;
+    }
+
+    /**
+     * Read the seek table at the end of a stream in the zstd contrib seekable
+     * format.
+     * @param input The whole compressed stream. Throws std::invalid_argument
+     * if it doesn't end in a valid seek table, or if an entry claims more
+     * than zstd_seekable_max_frame_size bytes or a size other than the one
+     * its frame header records.
+     * @return Where each frame sits in the compressed and the decompressed
+     * stream, in order.
+     */
+    inline auto zstd_read_seek_table(std::span<uint8_t const> input) -> std::vector<zstd_seekable_frame>
+    {
+        if (input.size() < zstd_skippable_header_size + zstd_seek_table_footer_size
+            || zstd_get_le32(input.last(sizeof(uint32_t))) != zstd_seekable_magic)
+        {
+            throw std::invalid_argument("zstd_seekable_decode: Input doesn't end with a seek table.");
+        }
+
+        auto const footer{ input.last(zstd_seek_table_footer_size) };
+        size_t const frame_count{ zstd_get_le32(footer) };
+        uint8_t const descriptor{ footer.subspan(sizeof(uint32_t)).front() };
+        if ((descriptor & 0x7C) != 0)
+        {
+            throw std::invalid_argument(std::format("zstd_seekable_decode: Seek table descriptor has reserved bits set: 0x{:02X}.", descriptor));
+        }
+
+        size_t const entry_size{ sizeof(zstd_seekable_entry) + ((descriptor & 0x80) != 0 ? sizeof(uint32_t) : 0) };
+        size_t const table_size{ (frame_count * entry_size) + zstd_seek_table_footer_size };
+        if (frame_count > zstd_seekable_max_frames || input.size() < table_size + zstd_skippable_header_size)
+        {
+            throw std::invalid_argument(std::format("zstd_seekable_decode: Seek table for {} frames doesn't fit in {} bytes.", frame_count, input.size()));
+        }
+
+        size_t const frames_size{ input.size() - table_size - zstd_skippable_header_size };
+        auto const header{ input.subspan(frames_size, zstd_skippable_header_size) };
+        if (zstd_get_le32(header) != zstd_seek_table_magic || zstd_get_le32(header.subspan(sizeof(uint32_t))) != table_size)
+        {
+            throw std::invalid_argument("zstd_seekable_decode: Seek table frame header is invalid.");
+        }
+
+        std::vector<zstd_seekable_frame> ret;
+        ret.reserve(frame_count);
+        auto entries{ input.subspan(frames_size + zstd_skippable_header_size, frame_count * entry_size) };
+        size_t compressed_offset{ 0 };
+        size_t decompressed_offset{ 0 };
+        for (size_t i{ 0 }; i < frame_count; ++i)
+        {
+            zstd_seekable_frame frame{};
+            frame.compressed_offset = compressed_offset;
+            frame.compressed_size = zstd_get_le32(entries);
+            frame.decompressed_offset = decompressed_offset;
+            frame.decompressed_size = zstd_get_le32(entries.subspan(sizeof(uint32_t)));
+            compressed_offset += frame.compressed_size;
+            decompressed_offset += frame.decompressed_size;
+            if (compressed_offset > frames_size)
+            {
+                throw std::invalid_argument(std::format("zstd_seekable_decode: Seek table frames run past the {} bytes of compressed data.", frames_size));
+            }
+
+            // the entry sizes the buffer the frame decompresses into, so don't take it on trust
+            if (frame.decompressed_size > zstd_seekable_max_frame_size)
+            {
+                throw std::invalid_argument(std::format("zstd_seekable_decode: Seek table entry {} claims {} bytes, more than a seekable frame holds.", i, frame.decompressed_size));
+            }
+
+            if (unsigned long long const content_size{ ZSTD_getFrameContentSize(input.subspan(frame.compressed_offset, frame.compressed_size).data(), frame.compressed_size) };
+                content_size != ZSTD_CONTENTSIZE_UNKNOWN && content_size != ZSTD_CONTENTSIZE_ERROR && content_size != frame.decompressed_size)
+            {
+                throw std::invalid_argument(std::format("zstd_seekable_decode: Seek table entry {} claims {} bytes, the frame header says {}.", i, frame.decompressed_size, content_size));
+            }
+
+            ret.push_back(frame);
+            entries = entries.subspan(entry_size);
+        }
+
+        return ret;
+    }
+}
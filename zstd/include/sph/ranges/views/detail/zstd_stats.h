@@ -0,0 +1,256 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace sph
+{
+    /**
+     * Counters for one zstd stream, kept when SPH_ZSTD_STATS is defined and
+     * left at zero otherwise.
+     *
+     * The three times don't overlap, so comparing them shows whether a slow
+     * pipeline is waiting on zstd, on reading the input range, or on handing
+     * out values.
+     */
+    struct zstd_stats
+    {
+        /**
+         * The bytes zstd consumed: uncompressed when encoding, compressed
+         * when decoding.
+         */
+        uint64_t bytes_in{ 0 };
+
+        /**
+         * The bytes zstd produced: compressed when encoding, decompressed
+         * when decoding.
+         */
+        uint64_t bytes_out{ 0 };
+
+        /**
+         * The calls to ZSTD_compressStream2(), ZSTD_decompressStream(), or
+         * their one-shot counterparts.
+         */
+        uint64_t zstd_calls{ 0 };
+
+        /**
+         * The calls to restage zstd's input from the input range, including
+         * the one that finds the end of it.
+         */
+        uint64_t in_refills{ 0 };
+
+        /**
+         * The calls to refill the output buffer values get handed out from.
+         */
+        uint64_t out_refills{ 0 };
+
+        /**
+         * The time spent inside zstd.
+         */
+        std::chrono::nanoseconds zstd_time{};
+
+        /**
+         * The time spent reading the input range into zstd's input buffer
+         * (load_next_in). With read ahead, the time spent waiting on the
+         * helper thread.
+         */
+        std::chrono::nanoseconds staging_time{};
+
+        /**
+         * The time between output buffer refills (load_next_value). That's
+         * handing out the values of each buffer plus whatever the code using
+         * the iterator does between increments.
+         */
+        std::chrono::nanoseconds value_time{};
+
+        /**
+         * Add another stream's counters to these.
+         * @param other The counters to add.
+         * @return These counters.
+         */
+        auto operator+=(zstd_stats const& other) -> zstd_stats&
+        {
+            bytes_in += other.bytes_in;
+            bytes_out += other.bytes_out;
+            zstd_calls += other.zstd_calls;
+            in_refills += other.in_refills;
+            out_refills += other.out_refills;
+            zstd_time += other.zstd_time;
+            staging_time += other.staging_time;
+            value_time += other.value_time;
+            return *this;
+        }
+    };
+
+    /**
+     * Gets handed the final counters of a stream.
+     */
+    using zstd_stats_callback = std::function<void(zstd_stats const&)>;
+}
+
+namespace sph::ranges::views::detail
+{
+#ifdef SPH_ZSTD_STATS
+    /**
+     * Keeps the zstd_stats for one compression or decompression context and
+     * reports them to the stats_callback of the parameters, if any, when it
+     * goes away.
+     */
+    class zstd_stats_recorder
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * Where a call to zstd started.
+         */
+        struct zstd_call
+        {
+            clock::time_point start;
+            size_t in_pos;
+            size_t out_pos;
+        };
+
+        /**
+         * Adds the time until it goes away to a counter, notes when it went
+         * away, or both.
+         */
+        class scope
+        {
+            std::chrono::nanoseconds* time_;
+            clock::time_point* stop_;
+            clock::time_point start_{ clock::now() };
+        public:
+            /**
+             * Initialize a new instance of the scope class.
+             * @param time The counter to add to; nullptr for none.
+             * @param stop Set to when the scope ends; nullptr for none.
+             */
+            scope(std::chrono::nanoseconds* time, clock::time_point* stop) : time_{ time }, stop_{ stop } {}
+            scope(scope const&) = delete;
+            scope(scope&&) = delete;
+            ~scope()
+            {
+                auto const now{ clock::now() };
+                if (time_ != nullptr)
+                {
+                    *time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_);
+                }
+
+                if (stop_ != nullptr)
+                {
+                    *stop_ = now;
+                }
+            }
+            auto operator=(scope const&) -> scope& = delete;
+            auto operator=(scope&&) -> scope& = delete;
+        };
+    private:
+        zstd_stats stats_{};
+        zstd_stats_callback callback_;
+        clock::time_point drain_start_{ clock::now() };
+    public:
+        /**
+         * Initialize a new instance of the zstd_stats_recorder class.
+         * @tparam P zstd_encode_parameters or zstd_decode_parameters.
+         * @param parameters Provides the stats_callback.
+         */
+        template<typename P>
+        explicit zstd_stats_recorder(P const& parameters) : callback_{ parameters.stats_callback } {}
+        zstd_stats_recorder(zstd_stats_recorder const&) = delete;
+        zstd_stats_recorder(zstd_stats_recorder&& o) noexcept
+            : stats_{ o.stats_ }, callback_{ std::exchange(o.callback_, nullptr) }, drain_start_{ o.drain_start_ } {}
+        ~zstd_stats_recorder()
+        {
+            if (callback_)
+            {
+                callback_(stats_);
+            }
+        }
+        auto operator=(zstd_stats_recorder const&) -> zstd_stats_recorder& = delete;
+        auto operator=(zstd_stats_recorder&&) -> zstd_stats_recorder& = delete;
+
+        /**
+         * @return The counters so far.
+         */
+        [[nodiscard]] auto stats() const -> zstd_stats const& { return stats_; }
+
+        /**
+         * Add counters kept elsewhere, for a stream split across workers.
+         * @param other The counters to add.
+         */
+        void add(zstd_stats const& other) { stats_ += other; }
+
+        /**
+         * Call just before calling zstd.
+         * @param in_pos The input buffer position.
+         * @param out_pos The output buffer position.
+         * @return Pass to end_zstd().
+         */
+        [[nodiscard]] static auto begin_zstd(size_t in_pos, size_t out_pos) -> zstd_call { return zstd_call{ clock::now(), in_pos, out_pos }; }
+
+        /**
+         * Call just after calling zstd.
+         * @param call From begin_zstd().
+         * @param in_pos The input buffer position.
+         * @param out_pos The output buffer position.
+         */
+        void end_zstd(zstd_call const& call, size_t in_pos, size_t out_pos)
+        {
+            stats_.zstd_time += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - call.start);
+            stats_.bytes_in += in_pos - call.in_pos;
+            stats_.bytes_out += out_pos - call.out_pos;
+            ++stats_.zstd_calls;
+        }
+
+        /**
+         * Time reading the input range.
+         * @return Keep until done reading.
+         */
+        [[nodiscard]] auto staging() -> scope
+        {
+            ++stats_.in_refills;
+            return scope{ &stats_.staging_time, nullptr };
+        }
+
+        /**
+         * Close out the time spent handing out the values of the last output
+         * buffer. The refill itself doesn't count toward value_time.
+         * @return Keep until done refilling.
+         */
+        [[nodiscard]] auto refilling() -> scope
+        {
+            ++stats_.out_refills;
+            stats_.value_time += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - drain_start_);
+            return scope{ nullptr, &drain_start_ };
+        }
+    };
+#else
+    /**
+     * Stands in for the stats recorder when SPH_ZSTD_STATS isn't defined.
+     * Everything compiles away, the counters stay at zero, and the
+     * stats_callback never gets called.
+     */
+    class zstd_stats_recorder
+    {
+    public:
+        struct zstd_call {};
+        struct [[maybe_unused]] scope {};
+
+        template<typename P>
+        explicit zstd_stats_recorder(P const& /*parameters*/) {}
+        [[nodiscard]] static auto stats() -> zstd_stats const&
+        {
+            static zstd_stats const none{};
+            return none;
+        }
+        static void add(zstd_stats const& /*other*/) {}
+        [[nodiscard]] static auto begin_zstd(size_t /*in_pos*/, size_t /*out_pos*/) -> zstd_call { return {}; }
+        static void end_zstd(zstd_call /*call*/, size_t /*in_pos*/, size_t /*out_pos*/) {}
+        [[nodiscard]] static auto staging() -> scope { return {}; }
+        [[nodiscard]] static auto refilling() -> scope { return {}; }
+    };
+#endif
+}
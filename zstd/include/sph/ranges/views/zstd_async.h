@@ -0,0 +1,470 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sph/ranges/views/zstd_decode_chunks.h>
+#include <sph/ranges/views/zstd_encode.h>
+
+namespace sph::ranges::views
+{
+    namespace detail
+    {
+        /**
+         * A bounded queue of blocks of values passed from the producer
+         * thread of a zstd_async_view to its consumer.
+         * @tparam T The type of the values.
+         */
+        template<typename T>
+        class zstd_async_channel
+        {
+            std::mutex mutex_;
+            std::condition_variable_any ready_;
+            std::deque<std::vector<T>> blocks_;
+            size_t depth_;
+            bool closed_{ false };
+            std::exception_ptr error_;
+        public:
+            /**
+             * Initialize a new instance of the zstd_async_channel class.
+             * @param depth The number of filled blocks that may wait for the
+             * consumer before the producer blocks.
+             */
+            explicit zstd_async_channel(size_t depth) : depth_{ std::max(static_cast<size_t>(1), depth) } {}
+
+            /**
+             * Hand a filled block to the consumer, waiting for room.
+             * @param block The block.
+             * @param stop Stops the wait when the consumer goes away.
+             * @return False if the consumer went away before there was room.
+             */
+            auto push(std::vector<T>&& block, std::stop_token const& stop) -> bool
+            {
+                std::unique_lock lock{ mutex_ };
+                if (!ready_.wait(lock, stop, [this] { return blocks_.size() < depth_; }))
+                {
+                    return false;
+                }
+
+                blocks_.push_back(std::move(block));
+                ready_.notify_all();
+                return true;
+            }
+
+            /**
+             * Tell the consumer no more blocks are coming.
+             * @param error The exception that stopped the producer, if any.
+             * The consumer gets it after the blocks ahead of it.
+             */
+            void close(std::exception_ptr error)
+            {
+                std::scoped_lock const lock{ mutex_ };
+                closed_ = true;
+                error_ = std::move(error);
+                ready_.notify_all();
+            }
+
+            /**
+             * Take the next filled block, waiting for the producer as needed.
+             *
+             * Rethrows the exception that stopped the producer once the
+             * blocks ahead of it are gone.
+             *
+             * @param block Gets the block.
+             * @return False at the end of the sequence.
+             */
+            auto pop(std::vector<T>& block) -> bool
+            {
+                std::unique_lock lock{ mutex_ };
+                ready_.wait(lock, [this] { return !blocks_.empty() || closed_; });
+                if (blocks_.empty())
+                {
+                    if (error_)
+                    {
+                        std::rethrow_exception(std::exchange(error_, nullptr));
+                    }
+
+                    return false;
+                }
+
+                block = std::move(blocks_.front());
+                blocks_.pop_front();
+                ready_.notify_all();
+                return true;
+            }
+        };
+
+        /**
+         * Provides a view of a zstd_encode or zstd_decode_chunks view that
+         * runs on a background thread.
+         *
+         * The background thread pulls the input range and does the zstd work,
+         * filling blocks of values that get queued for the consumer. It takes
+         * zstd's output a buffer at a time: whole chunks from
+         * zstd_decode_chunks and, through take_values(), whole compressed
+         * buffers from zstd_encode. While the consumer works through one
+         * block, the background thread fills the next, so reading the input,
+         * zstd, and whatever the consumer does with the values overlap
+         * instead of taking turns.
+         *
+         * The input range gets read on the background thread, so nothing
+         * else may touch it while an iterator is live. Leaving early stops
+         * the background thread before its next value.
+         *
+         * @tparam V The type of the view that does the zstd work.
+         * @tparam T The type of the values the view produces.
+         */
+        template<std::ranges::input_range V, typename T>
+        class zstd_async_view : public std::ranges::view_interface<zstd_async_view<V, T>> {
+            std::shared_ptr<V const> inner_;
+            size_t depth_;
+            size_t block_size_;
+        public:
+            /**
+             * Initialize a new instance of the zstd_async_view class.
+             * @param inner The view that does the zstd work.
+             * @param depth The number of filled blocks that may wait for the
+             * consumer.
+             * @param block_size The number of values in a block.
+             */
+            zstd_async_view(V&& inner, size_t depth, size_t block_size)
+                : inner_{ std::make_shared<V const>(std::move(inner)) }, depth_{ depth }, block_size_{ std::max(static_cast<size_t>(1), block_size) } {}
+
+            /**
+             * Forward declaration of the zstd_async_view end-of-sequence
+             * sentinel.
+             */
+            struct sentinel;
+
+            /**
+             * The iterator for the zstd_async_view.
+             *
+             * Copies share the background thread and the current block, so
+             * incrementing one advances them all.
+             */
+            class iterator
+            {
+            public:
+                using iterator_concept = std::input_iterator_tag;
+                using iterator_category = std::input_iterator_tag;
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+            private:
+                /**
+                 * The state the iterator copies share. The background thread
+                 * gets stopped and joined before the channel goes away.
+                 */
+                struct state
+                {
+                    zstd_async_channel<value_type> channel;
+                    std::vector<value_type> block;
+                    size_t block_pos{ 0 };
+                    bool at_end{ false };
+                    std::jthread producer;
+
+                    explicit state(size_t depth) : channel{ depth } {}
+                };
+
+                std::shared_ptr<state> state_;
+            public:
+                /**
+                 * Initialize a new instance of the zstd_async_view::iterator
+                 * class, starting the background thread.
+                 * @param inner The view that does the zstd work.
+                 * @param depth The number of filled blocks that may wait for
+                 * the consumer.
+                 * @param block_size The number of values in a block.
+                 */
+                iterator(std::shared_ptr<V const> inner, size_t depth, size_t block_size)
+                    : state_{ std::make_shared<state>(depth) }
+                {
+                    state_->producer = std::jthread(produce, std::move(inner), std::ref(state_->channel), block_size);
+                    load_next_block();
+                }
+
+                /**
+                 * Increment the iterator.
+                 * @return The incremented iterator value.
+                 */
+                auto operator++() -> iterator&
+                {
+                    if (++state_->block_pos == state_->block.size())
+                    {
+                        load_next_block();
+                    }
+
+                    return *this;
+                }
+
+                /**
+                 * Increment the iterator.
+                 */
+                void operator++(int)
+                {
+                    ++*this;
+                }
+
+                /**
+                 * Compare the provided iterator for equality.
+                 * @param i The iterator to compare against.
+                 * @return True if the provided iterator shares this one's
+                 * state, and so its position.
+                 */
+                auto equals(const iterator& i) const noexcept -> bool
+                {
+                    return state_ == i.state_;
+                }
+
+                /**
+                 * Compare the provided sentinel for equality.
+                 * @return True if at the end of the view.
+                 */
+                auto equals(const sentinel&) const noexcept -> bool
+                {
+                    return state_->at_end;
+                }
+
+                /**
+                 * Gets the current value.
+                 * @return The current value.
+                 */
+                auto operator*() const -> value_type
+                {
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                    return state_->block[state_->block_pos];
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                }
+
+                auto operator==(const iterator& other) const noexcept -> bool { return equals(other); }
+                auto operator==(const sentinel& s) const noexcept -> bool { return equals(s); }
+                auto operator!=(const iterator& other) const noexcept -> bool { return !equals(other); }
+                auto operator!=(const sentinel& s) const noexcept -> bool { return !equals(s); }
+
+            private:
+                /**
+                 * Move to the next block the background thread filled,
+                 * waiting for it as needed.
+                 *
+                 * Rethrows whatever exception stopped the background thread.
+                 */
+                void load_next_block()
+                {
+                    auto& s{ *state_ };
+                    s.block_pos = 0;
+                    s.block.clear();
+                    while (s.block.empty())
+                    {
+                        if (!s.channel.pop(s.block))
+                        {
+                            s.at_end = true;
+                            return;
+                        }
+                    }
+                }
+
+                /**
+                 * Pull the view that does the zstd work and queue up what it
+                 * produces. Runs on the background thread.
+                 * @param stop Set when the consumer goes away.
+                 * @param inner The view that does the zstd work.
+                 * @param channel Where to queue the blocks.
+                 * @param block_size The number of values in a block.
+                 */
+                static void produce(std::stop_token const& stop, std::shared_ptr<V const> const& inner, zstd_async_channel<value_type>& channel, size_t block_size)
+                {
+                    try
+                    {
+                        std::vector<value_type> block;
+                        if constexpr (requires(std::ranges::iterator_t<V const>& i) { i.take_values(block); })
+                        {
+                            // take each compressed buffer whole
+                            block.reserve(2 * block_size);
+                            auto const end{ inner->end() };
+                            for (auto i{ inner->begin() }; i != end;)
+                            {
+                                if (stop.stop_requested())
+                                {
+                                    return;
+                                }
+
+                                i.take_values(block);
+                                if (block.size() >= block_size)
+                                {
+                                    if (!channel.push(std::exchange(block, {}), stop))
+                                    {
+                                        return;
+                                    }
+
+                                    block.reserve(2 * block_size);
+                                }
+                            }
+                        }
+                        else
+                        {
+                            block.reserve(block_size);
+                            for (auto&& value : *inner)
+                            {
+                                if (stop.stop_requested())
+                                {
+                                    return;
+                                }
+
+                                block.insert(block.end(), std::ranges::begin(value), std::ranges::end(value));
+                                if (block.size() >= block_size)
+                                {
+                                    if (!channel.push(std::exchange(block, {}), stop))
+                                    {
+                                        return;
+                                    }
+
+                                    block.reserve(block_size);
+                                }
+                            }
+                        }
+
+                        if (!block.empty() && !channel.push(std::move(block), stop))
+                        {
+                            return;
+                        }
+
+                        channel.close(nullptr);
+                    }
+                    catch (...)
+                    {
+                        channel.close(std::current_exception());
+                    }
+                }
+            };
+
+            struct sentinel
+            {
+                auto operator==(const sentinel& /*other*/) const -> bool { return true; }
+                auto operator==(const iterator& i) const -> bool { return i.equals(*this); }
+                auto operator!=(const sentinel& /*other*/) const -> bool { return false; }
+                auto operator!=(const iterator& i) const -> bool { return !i.equals(*this); }
+            };
+
+            iterator begin() const { return iterator(inner_, depth_, block_size_); }
+
+            sentinel end() const { return sentinel{}; }
+        };
+
+        /**
+         * Functor that, given a range, provides a zstd compressed view of
+         * that range that compresses on a background thread.
+         * @tparam T The type to compress into.
+         */
+        template <typename T>
+        class zstd_encode_async_fn : public std::ranges::range_adaptor_closure<zstd_encode_async_fn<T>>
+        {
+            zstd_encode_parameters parameters_;
+            size_t depth_;
+        public:
+            explicit zstd_encode_async_fn(zstd_encode_parameters parameters = {}, size_t depth = 2) : parameters_{ std::move(parameters) }, depth_{ depth } {}
+            template <std::ranges::viewable_range R>
+            [[nodiscard]] constexpr auto operator()(R&& range) const -> zstd_async_view<zstd_encode_view<std::views::all_t<R>, T>, T>
+            {
+                return zstd_async_view<zstd_encode_view<std::views::all_t<R>, T>, T>(
+                    zstd_encode_view<std::views::all_t<R>, T>(parameters_, std::views::all(std::forward<R>(range))), depth_, zstd_staging_size(parameters_.out_buffer_size, ZSTD_CStreamOutSize()) / sizeof(T));
+            }
+        };
+
+        /**
+         * Functor that, given a zstd compressed range, provides a view of the
+         * decompressed values that decompresses on a background thread.
+         * @tparam T The type to decompress into.
+         */
+        template <typename T>
+        class zstd_decode_async_fn : public std::ranges::range_adaptor_closure<zstd_decode_async_fn<T>>
+        {
+            zstd_decode_parameters parameters_;
+            size_t depth_;
+        public:
+            explicit zstd_decode_async_fn(zstd_decode_parameters parameters = {}, size_t depth = 2) : parameters_{ std::move(parameters) }, depth_{ depth } {}
+            template <std::ranges::viewable_range R>
+            [[nodiscard]] constexpr auto operator()(R&& range) const -> zstd_async_view<zstd_decode_chunks_view<std::views::all_t<R>, T>, T>
+            {
+                return zstd_async_view<zstd_decode_chunks_view<std::views::all_t<R>, T>, T>(
+                    zstd_decode_chunks_view<std::views::all_t<R>, T>(parameters_, std::views::all(std::forward<R>(range))), depth_, zstd_staging_size(parameters_.out_buffer_size, ZSTD_DStreamOutSize()) / sizeof(T));
+            }
+        };
+    }
+}
+
+namespace sph::views
+{
+    /**
+     * A range adaptor that represents view of an underlying sequence after
+     * applying zstd compression on a background thread.
+     *
+     * Produces the same values as zstd_encode. The background thread reads
+     * the input and compresses up to depth blocks of about out_buffer_size
+     * bytes ahead of the consumer, so a pipeline that
+     * reads from disk, compresses, and writes to the network runs at about
+     * the speed of its slowest stage rather than the sum of them:
+     *
+     * ```c++
+     * for (auto value : file_bytes | sph::views::zstd_encode_async())
+     * {
+     *     socket.send(value);
+     * }
+     * ```
+     *
+     * The input range gets read on the background thread, so nothing else
+     * may touch it while the view is being iterated.
+     *
+     * @tparam T The type to compress into. Defaults to uint8_t. Larger types may end up with a zstd skippable frame as padding.
+     * @param parameters The zstd compression parameters.
+     * @param depth The number of compressed blocks that may wait for the
+     * consumer before the background thread stops to wait.
+     * @return A functor that takes a range and returns a view of the compressed information.
+     */
+    template<typename T = uint8_t>
+    auto zstd_encode_async(zstd_encode_parameters const& parameters = {}, size_t depth = 2) -> sph::ranges::views::detail::zstd_encode_async_fn<T>
+    {
+        return sph::ranges::views::detail::zstd_encode_async_fn<T>{ parameters, depth };
+    }
+
+    /**
+     * A range adaptor that represents view of an underlying sequence after
+     * applying zstd decompression on a background thread.
+     *
+     * Produces the same values as zstd_decode. The background thread reads
+     * the input and decompresses up to depth blocks of about out_buffer_size
+     * bytes ahead of the consumer.
+     *
+     * The input range gets read on the background thread, so nothing else
+     * may touch it while the view is being iterated.
+     *
+     * Will fail to decompress and throw a std::invalid_argument if the
+     * provided range does not represent a valid zstd compressed stream. The
+     * exception comes out of the increment that reaches the failure.
+     *
+     * @tparam T The type to decompress into.
+     * @param parameters The zstd decompression parameters.
+     * @param depth The number of decompressed blocks that may wait for the
+     * consumer before the background thread stops to wait.
+     * @return A functor that takes a zstd compressed range and returns a view of the decompressed information.
+     */
+    template<typename T = uint8_t>
+    auto zstd_decode_async(zstd_decode_parameters const& parameters = {}, size_t depth = 2) -> sph::ranges::views::detail::zstd_decode_async_fn<T>
+    {
+        return sph::ranges::views::detail::zstd_decode_async_fn<T>{ parameters, depth };
+    }
+}
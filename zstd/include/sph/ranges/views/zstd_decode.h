@@ -1,8 +1,12 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <format>
+#include <iterator>
 #include <ranges>
 #include <stdexcept>
-#include <sph/ranges/views/detail/zstd_decompress.h>
+#include <sph/ranges/views/detail/zstd_decode_stream.h>
 
 namespace sph::ranges::views
 {
@@ -17,7 +21,7 @@ namespace sph::ranges::views
             requires std::ranges::input_range<R> && std::is_standard_layout_v<T>&& std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<R>>>
         class zstd_decode_view : public std::ranges::view_interface<zstd_decode_view<R, T>> {
             R input_;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
-            int window_log_max_;
+            zstd_decode_parameters parameters_;
         public:
             /**
              * Initialize a new instance of the zstd_decode_view class.
@@ -29,15 +33,11 @@ namespace sph::ranges::views
              * stream. Failure to provide a valid stream will result in a
              * std::invalid_argument exception.
              * 
-             * @param window_log_max Size limit (in powers of 2) beyond which
-             * the decompressor will refuse to allocate a memory buffer in
-             * order to protect the host; zero for default. Valid values
-             * (typically): 11 through 30 (32-bit), 11 through 31 (64-bit).
-             * Out of range values will be clamped.
+             * @param parameters The zstd decompression parameters.
              * @param input the range to decompress.
              */
-            zstd_decode_view(int window_log_max, R&& input)  // NOLINT(cppcoreguidelines-rvalue-reference-param-not-moved)
-                : input_(std::forward<R>(input)), window_log_max_{window_log_max} {}
+            zstd_decode_view(zstd_decode_parameters parameters, R&& input)  // NOLINT(cppcoreguidelines-rvalue-reference-param-not-moved)
+                : input_(std::forward<R>(input)), parameters_{std::move(parameters)} {}
 
             zstd_decode_view(zstd_decode_view const&) = default;
             zstd_decode_view(zstd_decode_view&&) = default;
@@ -46,6 +46,7 @@ namespace sph::ranges::views
             auto operator=(zstd_decode_view&&o) noexcept -> zstd_decode_view&
             {
                 // not sure why "= default" doesn't work here...
+                parameters_ = std::move(o.parameters_);
                 input_ = std::move(std::forward<zstd_decode_view>(o).input_);
                 return *this;
             }
@@ -60,7 +61,7 @@ namespace sph::ranges::views
              * The iterator for the zstd_decode_view providing a view of the
              * decompressed stream.
              *
-             * This uses the zstd_decompressor class to do the work.
+             * This uses the zstd_decode_stream class to do the work.
              */
             class iterator
             {
@@ -73,27 +74,27 @@ namespace sph::ranges::views
                 using reference = const T&;
 				using input_type = std::remove_cvref_t<std::ranges::range_value_t<R>>;
             private:
-                zstd_decompressor decompress_;
-                std::ranges::const_iterator_t<R> current_;
-                size_t current_pos_{ 0 };
-                std::ranges::const_sentinel_t<R> end_;
-                value_type value_;
-                bool maybe_done_{ false };
+                /**
+                 * Multibyte values get block copied out of the decompressed
+                 * buffer this many bytes' worth at a time.
+                 */
+                static constexpr size_t value_cache_bytes{ 256 };
+                static constexpr size_t value_cache_size{ sizeof(value_type) > 1 ? std::max(static_cast<size_t>(1), value_cache_bytes / sizeof(value_type)) : 1 };
+                zstd_decode_stream<R> stream_;
+                std::array<value_type, value_cache_size> values_{};
+                size_t value_index_{ 0 };
+                size_t value_count_{ 0 };
                 bool at_end_{ false };
             public:
                 /**
                  * Initialize a new instance of the zstd_decode_view::iterator
                  * class.
-                 * @param window_log_max Size limit (in powers of 2) beyond
-                 * which the decompressor will refuse to allocate a memory
-                 * buffer in order to protect the host; zero for default. Valid
-                 * values (typically): 11 through 30 (32-bit), 11 through 31
-                 * (64-bit). Out of range values will be clamped.
+                 * @param parameters The zstd decompression parameters.
                  * @param begin The start of the input range to decompress.
                  * @param end The end of the input range.
                  */
-                iterator(int window_log_max, std::ranges::const_iterator_t<R> begin, std::ranges::const_sentinel_t<R> end)
-                    : decompress_{window_log_max}, current_(std::move(begin)), end_(std::move(end))
+                iterator(zstd_decode_parameters const& parameters, std::ranges::const_iterator_t<R> begin, std::ranges::const_sentinel_t<R> end)
+                    : stream_{parameters, std::move(begin), std::move(end)}
                 {
                     load_next_value();
                 }
@@ -127,7 +128,7 @@ namespace sph::ranges::views
                  */
                 auto equals(const iterator& i) const noexcept -> bool
                 {
-                    return current_ == i.current_ && decompress_.in().pos == i.decompress_.in().pos && decompress_.out().pos == i.decompress_.out().pos;
+                    return stream_.equals(i.stream_) && value_index_ == i.value_index_;
                 }
 
                 /**
@@ -145,7 +146,7 @@ namespace sph::ranges::views
                  */
                 auto operator*() const -> value_type
                 {
-	                return value_;
+	                return values_[value_index_];
                 }
 
                 auto operator==(const iterator& other) const noexcept -> bool { return equals(other); }
@@ -153,9 +154,20 @@ namespace sph::ranges::views
                 auto operator!=(const iterator& other) const noexcept -> bool { return !equals(other); }
                 auto operator!=(const sentinel&s) const noexcept -> bool { return !equals(s); }
 
+                /**
+                 * @return The counters for the stream so far; zero without
+                 * SPH_ZSTD_STATS. Shared with copies of the iterator.
+                 */
+                [[nodiscard]] auto stats() const -> zstd_stats const& { return stream_.stats(); }
+
             private:
                 /**
-                 * Sets _value to the next decompressed value.
+                 * Moves to the next decompressed value.
+                 *
+                 * Multibyte values get block copied from the decompressed
+                 * buffer into values_ so most increments just bump
+                 * value_index_. Only a value that straddles two decompressed
+                 * buffers gets assembled a byte at a time.
                  *
                  * Will throw std::invalid_argument for a truncated or otherwise invalid input range.
                  */
@@ -163,19 +175,42 @@ namespace sph::ranges::views
                 {
                     if constexpr (sizeof(value_type) > 1)
                     {
+                        if (++value_index_ < value_count_)
+                        {
+                            return;
+                        }
+
+                        value_index_ = 0;
+                        auto& out{ stream_.out() };
+                        value_count_ = std::min((out.size - out.pos) / sizeof(value_type), values_.size());
+                        if (value_count_ > 0)
+                        {
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                            std::memcpy(reinterpret_cast<uint8_t*>(values_.data()), static_cast<uint8_t const*>(out.dst) + out.pos, value_count_ * sizeof(value_type));
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                            out.pos += value_count_ * sizeof(value_type);
+                            return;
+                        }
+
+                        value_count_ = 1;
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage-in-container"
 #endif
-                        for (std::span<uint8_t, sizeof(value_type)> vs{ reinterpret_cast<uint8_t*>(&value_), sizeof(value_type) }; auto t : std::views::enumerate(vs))
+                        for (std::span<uint8_t, sizeof(value_type)> vs{ reinterpret_cast<uint8_t*>(values_.data()), sizeof(value_type) }; auto t : std::views::enumerate(vs))
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
                         {
                             auto [v_count, v] {t};
-                            if (decompress_.out().pos >= decompress_.out().size)
+                            if (stream_.out().pos >= stream_.out().size)
                             {
-                                if (load_next_out() == false)
+                                if (stream_.load_next_out() == false)
                                 {
                                     if (v_count > 0)
                                     {
@@ -183,7 +218,7 @@ namespace sph::ranges::views
                                     }
 
                                     at_end_ = true;
-                                    if (!maybe_done_)
+                                    if (!stream_.maybe_done())
                                     {
                                         throw std::invalid_argument("zstd_decode: Truncated input. Failed decompression at end of input.");
                                     }
@@ -196,22 +231,22 @@ namespace sph::ranges::views
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
 #endif
-                            v = static_cast<uint8_t const*>(decompress_.out().dst)[decompress_.out().pos];
+                            v = static_cast<uint8_t const*>(stream_.out().dst)[stream_.out().pos];
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
-                            ++decompress_.out().pos;
+                            ++stream_.out().pos;
                         }
                     }
                     else
                     {
                         // value_type is a single byte
-                        if (decompress_.out().pos >= decompress_.out().size)
+                        if (stream_.out().pos >= stream_.out().size)
                         {
-                            if (load_next_out() == false)
+                            if (stream_.load_next_out() == false)
                             {
                                 at_end_ = true;
-                                if (!maybe_done_)
+                                if (!stream_.maybe_done())
                                 {
                                     throw std::invalid_argument("zstd_decode: Truncated input. Failed decompression at end of input.");
                                 }
@@ -224,126 +259,12 @@ namespace sph::ranges::views
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
 #endif
-                        value_ = static_cast<value_type*>(decompress_.out().dst)[decompress_.out().pos];
+                        values_[0] = static_cast<value_type*>(stream_.out().dst)[stream_.out().pos];
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
 
-                        ++decompress_.out().pos;
-                    }
-                }
-
-                /**
-                 * Performs decompression on the next chunk, loading the next chunk as needed.
-                 * @return True if more input; false otherwise.
-                 */
-                auto load_next_out() -> bool
-                {
-                    if (decompress_.in().pos >= decompress_.in().size)
-                    {
-                        if (load_next_in() == false)
-                        {
-                            return false;
-                        }
-                    }
-
-                    maybe_done_ = decompress_();
-                    return !maybe_done_ || decompress_.out().size > 0;
-                }
-
-                /**
-                 * Load the next chunk into the buffer the decompressor works on.
-                 * @return True if not at end; false otherwise.
-                 */
-                auto load_next_in() -> bool
-                {
-                    if (current_ == end_)
-                    {
-                        return false;
-                    }
-
-                    size_t i{ 0 };
-                    if constexpr (sizeof(input_type) == 1)
-					{
-                        while (true)
-                        {
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
-#endif
-                            decompress_.in_src()[i] = static_cast<uint8_t>(*current_);
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
-                            ++i;
-                            ++current_;
-                            if (i == decompress_.in_max_size())
-                            {
-                                decompress_.in().size = i;
-                                decompress_.in().pos = 0;
-                                return true;
-                            }
-
-                            if (current_ == end_)
-                            {
-                                decompress_.in().size = i;
-                                decompress_.in().pos = 0;
-                                if (i == 0)
-                                {
-                                    return false;
-                                }
-
-                                return true;
-                            }
-                        }
-                    }
-					else
-					{
-	                    input_type current{ *current_ };
-	                    while(true)
-	                    {
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
-#endif
-	                        decompress_.in_src()[i] = reinterpret_cast<uint8_t const*>(&current)[current_pos_];
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
-                            ++i;
-	                        ++current_pos_;
-	                        if (i == decompress_.in_max_size())
-	                        {
-	                            if (current_pos_ == sizeof(input_type))
-	                            {
-	                                ++current_;
-	                                current_pos_ = 0;
-	                            }
-
-	                            decompress_.in().size = i;
-	                            decompress_.in().pos = 0;
-	                            return true;
-	                        }
-
-	                        if (current_pos_ == sizeof(input_type))
-	                        {
-	                            ++current_;
-	                            if (current_ == end_)
-	                            {
-	                                decompress_.in().size = i;
-	                                decompress_.in().pos = 0;
-	                                if (i == 0)
-	                                {
-	                                    return false;
-	                                }
-
-	                                return true;
-	                            }
-
-	                            current = *current_;
-	                            current_pos_ = 0;
-	                        }
-	                    }
+                        ++stream_.out().pos;
                     }
                 }
             };
@@ -356,7 +277,21 @@ namespace sph::ranges::views
                 auto operator!=(const iterator& i) const -> bool { return !i.equals(*this); }
             };
 
-            iterator begin() const { return iterator(window_log_max_, std::ranges::begin(input_), std::ranges::end(input_)); }
+            iterator begin() const { return iterator(parameters_, std::ranges::begin(input_), std::ranges::end(input_)); }
+
+            /**
+             * Get the number of values the view will produce, if the frame
+             * headers record it, so the caller can reserve space up front.
+             *
+             * Only available for contiguous compressed input.
+             *
+             * @return The number of decompressed values; zero if unknown.
+             */
+            [[nodiscard]] auto reserve_hint() const -> size_t
+                requires zstd_decode_stream<R>::contiguous_input
+            {
+                return zstd_decode_stream<R>::content_size(std::ranges::begin(input_), std::ranges::end(input_)) / sizeof(T);
+            }
 
             sentinel end() const { return sentinel{}; }
         };
@@ -371,13 +306,13 @@ namespace sph::ranges::views
         template <typename T>
         class zstd_decode_fn : public std::ranges::range_adaptor_closure<zstd_decode_fn<T>>
         {
-            int window_log_max_;
+            zstd_decode_parameters parameters_;
         public:
-            explicit zstd_decode_fn(int window_log_max = 0) : window_log_max_{ window_log_max } {}
+            explicit zstd_decode_fn(zstd_decode_parameters parameters = {}) : parameters_{ std::move(parameters) } {}
             template <std::ranges::viewable_range R>
             [[nodiscard]] constexpr auto operator()(R&& range) const -> zstd_decode_view<std::views::all_t<R>, T>
             {
-                return zstd_decode_view<std::views::all_t<R>, T>(window_log_max_, std::views::all(std::forward<R>(range)));
+                return zstd_decode_view<std::views::all_t<R>, T>(parameters_, std::views::all(std::forward<R>(range)));
             }
         };
     }
@@ -401,6 +336,32 @@ namespace sph::views
 	template<typename T = uint8_t>
     auto zstd_decode(int window_log_max = 0) -> sph::ranges::views::detail::zstd_decode_fn<T>
     {
-        return sph::ranges::views::detail::zstd_decode_fn<T>{window_log_max};
+        zstd_decode_parameters parameters{};
+        parameters.window_log_max = window_log_max;
+        return sph::ranges::views::detail::zstd_decode_fn<T>{parameters};
+    }
+
+	/**
+     * A range adaptor that represents view of an underlying sequence after applying zstd decompression to each element.
+     *
+     * Will fail to decompress and throw a std::invalid_argument if the
+     * provided range does not represent a valid zstd compressed stream or
+     * was compressed with a dictionary other than the one provided.
+     *
+     * Example:
+     * <pre>
+     * sph::zstd_decode_parameters parameters{};
+     * parameters.dictionary = sph::zstd_decode_dictionary{ dictionary_bytes };
+     * auto decompressed{ compressed | sph::views::zstd_decode(parameters) };
+     * </pre>
+     *
+     * @tparam T The type to decompress into.
+     * @param parameters The zstd decompression parameters.
+     * @return A functor that takes a zstd compressed range and returns a view of the decompressed information.
+	 */
+	template<typename T = uint8_t>
+    auto zstd_decode(zstd_decode_parameters const& parameters) -> sph::ranges::views::detail::zstd_decode_fn<T>
+    {
+        return sph::ranges::views::detail::zstd_decode_fn<T>{parameters};
     }
 }
@@ -0,0 +1,285 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <format>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <sph/ranges/views/detail/zstd_decode_stream.h>
+
+namespace sph::ranges::views
+{
+    namespace detail
+    {
+        /**
+         * Provides a view of an underlying zstd compressed sequence as a
+         * sequence of decompressed blocks.
+         *
+         * Each element is a std::span<const T> over one fill of the zstd
+         * output buffer. The span is only valid until the iterator is
+         * incremented.
+         *
+         * @tparam R The type of the range that holds a zstd compressed stream.
+         * @tparam T The type to decompress into.
+         */
+        template<std::ranges::viewable_range R, typename T>
+            requires std::ranges::input_range<R> && std::is_standard_layout_v<T> && std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<R>>>
+                && (alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        class zstd_decode_chunks_view : public std::ranges::view_interface<zstd_decode_chunks_view<R, T>> {
+            R input_;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+            zstd_decode_parameters parameters_;
+        public:
+            /**
+             * Initialize a new instance of the zstd_decode_chunks_view class.
+             *
+             * The given input range must comprise a valid zstd compressed
+             * stream. Failure to provide a valid stream will result in a
+             * std::invalid_argument exception.
+             *
+             * @param parameters The zstd decompression parameters.
+             * @param input the range to decompress.
+             */
+            zstd_decode_chunks_view(zstd_decode_parameters parameters, R&& input)  // NOLINT(cppcoreguidelines-rvalue-reference-param-not-moved)
+                : input_(std::forward<R>(input)), parameters_{ std::move(parameters) } {}
+
+            zstd_decode_chunks_view(zstd_decode_chunks_view const&) = default;
+            zstd_decode_chunks_view(zstd_decode_chunks_view&&) = default;
+            ~zstd_decode_chunks_view() noexcept = default;
+            auto operator=(zstd_decode_chunks_view const&) -> zstd_decode_chunks_view& = default;
+            auto operator=(zstd_decode_chunks_view&& o) noexcept -> zstd_decode_chunks_view&
+            {
+                parameters_ = std::move(o.parameters_);
+                input_ = std::move(std::forward<zstd_decode_chunks_view>(o).input_);
+                return *this;
+            }
+
+            /**
+             * Forward declaration of the zstd_decode_chunks_view
+             * end-of-sequence sentinel.
+             */
+            struct sentinel;
+
+            /**
+             * The iterator for the zstd_decode_chunks_view providing a view
+             * of the decompressed stream one block at a time.
+             *
+             * A value that straddles two zstd output buffer fills gets moved
+             * to the front of the next block.
+             */
+            class iterator
+            {
+            public:
+                using iterator_concept = std::input_iterator_tag;
+                using iterator_category = std::input_iterator_tag;
+                using value_type = std::span<const T>;
+                using difference_type = std::ptrdiff_t;
+            private:
+                zstd_decode_stream<R> stream_;
+                value_type chunk_;
+                bool at_end_{ false };
+            public:
+                /**
+                 * Initialize a new instance of the
+                 * zstd_decode_chunks_view::iterator class.
+                 * @param parameters The zstd decompression parameters.
+                 * @param begin The start of the input range to decompress.
+                 * @param end The end of the input range.
+                 */
+                iterator(zstd_decode_parameters const& parameters, std::ranges::const_iterator_t<R> begin, std::ranges::const_sentinel_t<R> end)
+                    : stream_{ parameters, std::move(begin), std::move(end) }
+                {
+                    load_next_chunk();
+                }
+
+                /**
+                 * Increment the iterator.
+                 * @return The incremented iterator value.
+                 */
+                auto operator++() -> iterator&
+                {
+                    load_next_chunk();
+                    return *this;
+                }
+
+                /**
+                 * Increment the iterator.
+                 */
+                void operator++(int)
+                {
+                    load_next_chunk();
+                }
+
+                /**
+                 * Compare the provided iterator for equality.
+                 * @param i The iterator to compare against.
+                 * @return True if the provided iterator is the same as this one.
+                 */
+                auto equals(const iterator& i) const noexcept -> bool
+                {
+                    return stream_.equals(i.stream_);
+                }
+
+                /**
+                 * Compare the provided sentinel for equality.
+                 * @return True if at the end of the decompressed view.
+                 */
+                auto equals(const sentinel&) const noexcept -> bool
+                {
+                    return at_end_;
+                }
+
+                /**
+                 * Gets the current block of decompressed values.
+                 * @return The current block of decompressed values. Valid
+                 * until the iterator is incremented.
+                 */
+                auto operator*() const -> value_type
+                {
+                    return chunk_;
+                }
+
+                auto operator==(const iterator& other) const noexcept -> bool { return equals(other); }
+                auto operator==(const sentinel& s) const noexcept -> bool { return equals(s); }
+                auto operator!=(const iterator& other) const noexcept -> bool { return !equals(other); }
+                auto operator!=(const sentinel& s) const noexcept -> bool { return !equals(s); }
+
+                /**
+                 * @return The counters for the stream so far; zero without
+                 * SPH_ZSTD_STATS. Shared with copies of the iterator.
+                 */
+                [[nodiscard]] auto stats() const -> zstd_stats const& { return stream_.stats(); }
+
+            private:
+                /**
+                 * Sets chunk_ to the next block of decompressed values.
+                 *
+                 * Will throw std::invalid_argument for a truncated or otherwise invalid input range.
+                 */
+                void load_next_chunk()
+                {
+                    auto& out{ stream_.out() };
+                    auto* const dst{ static_cast<uint8_t*>(out.dst) };
+                    size_t keep{ 0 };
+                    if (out.pos < out.size)
+                    {
+                        // a partial value at the end of the last block moves to the front of the next one
+                        keep = out.size - out.pos;
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                        std::copy(dst + out.pos, dst + out.size, dst);
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                    }
+
+                    while (true)
+                    {
+                        if (!stream_.load_next_out(keep))
+                        {
+                            if (keep > 0)
+                            {
+                                throw std::invalid_argument(std::format("zstd_decode_chunks: Partial type at end of data. Required {} bytes, received {}.", sizeof(T), keep));
+                            }
+
+                            at_end_ = true;
+                            chunk_ = {};
+                            if (!stream_.maybe_done())
+                            {
+                                throw std::invalid_argument("zstd_decode_chunks: Truncated input. Failed decompression at end of input.");
+                            }
+
+                            return;
+                        }
+
+                        size_t const count{ out.size / sizeof(T) };
+                        out.pos = count * sizeof(T);
+                        if (count > 0)
+                        {
+                            chunk_ = value_type{ static_cast<T const*>(out.dst), count };
+                            return;
+                        }
+
+                        keep = out.size;
+                    }
+                }
+            };
+
+            struct sentinel
+            {
+                auto operator==(const sentinel& /*other*/) const -> bool { return true; }
+                auto operator==(const iterator& i) const -> bool { return i.equals(*this); }
+                auto operator!=(const sentinel& /*other*/) const -> bool { return false; }
+                auto operator!=(const iterator& i) const -> bool { return !i.equals(*this); }
+            };
+
+            iterator begin() const { return iterator(parameters_, std::ranges::begin(input_), std::ranges::end(input_)); }
+
+            sentinel end() const { return sentinel{}; }
+        };
+
+        /**
+         * Functor that, given a zstd compressed range, provides a view of the
+         * decompressed blocks of that range.
+         * @tparam T The type to decompress into.
+         */
+        template <typename T>
+        class zstd_decode_chunks_fn : public std::ranges::range_adaptor_closure<zstd_decode_chunks_fn<T>>
+        {
+            zstd_decode_parameters parameters_;
+        public:
+            explicit zstd_decode_chunks_fn(zstd_decode_parameters parameters = {}) : parameters_{ std::move(parameters) } {}
+            template <std::ranges::viewable_range R>
+            [[nodiscard]] constexpr auto operator()(R&& range) const -> zstd_decode_chunks_view<std::views::all_t<R>, T>
+            {
+                return zstd_decode_chunks_view<std::views::all_t<R>, T>(parameters_, std::views::all(std::forward<R>(range)));
+            }
+        };
+    }
+}
+
+namespace sph::views
+{
+    /**
+     * A range adaptor that represents view of an underlying sequence after
+     * applying zstd decompression, one decompressed block at a time.
+     *
+     * Each element is a std::span<const T> over up to out_buffer_size bytes
+     * (by default ZSTD_DStreamOutSize()) of decompressed data. That lets the
+     * caller copy or scan whole blocks instead of pulling one value at a
+     * time. Each span is only valid until the iterator is incremented.
+     *
+     * Will fail to decompress and throw a std::invalid_argument if the
+     * provided range does not represent a valid zstd compressed stream.
+     *
+     * @tparam T The type to decompress into.
+     * @param window_log_max Size limit (in powers of 2) beyond which the
+     * decompressor will refuse to allocate a memory buffer in order to protect
+     * the host; zero for default. Valid values (typically): 11 through 30
+     * (32-bit), 11 through 31 (64-bit). Out of range values will be clamped.
+     * @return A functor that takes a zstd compressed range and returns a view of the decompressed blocks.
+     */
+    template<typename T = uint8_t>
+    auto zstd_decode_chunks(int window_log_max = 0) -> sph::ranges::views::detail::zstd_decode_chunks_fn<T>
+    {
+        zstd_decode_parameters parameters{};
+        parameters.window_log_max = window_log_max;
+        return sph::ranges::views::detail::zstd_decode_chunks_fn<T>{parameters};
+    }
+
+    /**
+     * A range adaptor that represents view of an underlying sequence after
+     * applying zstd decompression, one decompressed block at a time.
+     *
+     * @tparam T The type to decompress into.
+     * @param parameters The zstd decompression parameters.
+     * @return A functor that takes a zstd compressed range and returns a view of the decompressed blocks.
+     */
+    template<typename T = uint8_t>
+    auto zstd_decode_chunks(zstd_decode_parameters const& parameters) -> sph::ranges::views::detail::zstd_decode_chunks_fn<T>
+    {
+        return sph::ranges::views::detail::zstd_decode_chunks_fn<T>{parameters};
+    }
+}
@@ -0,0 +1,552 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sph/ranges/views/detail/zstd_decode_stream.h>
+
+namespace sph::ranges::views
+{
+    namespace detail
+    {
+        /**
+         * Provides view of an underlying multi-frame zstd compressed sequence
+         * after decompressing its frames concurrently.
+         *
+         * Zstd frames are independent, so the iterator walks the frame
+         * headers with ZSTD_findFrameCompressedSize() and queues runs of
+         * frames for a pool of worker threads, keeping up to one run per
+         * worker in flight ahead of the values being handed out. Each worker
+         * lives as long as the iterator and reuses one decompression context
+         * for all its runs. The values come out in the same order as from
+         * zstd_decode_view.
+         *
+         * A single frame decompresses on a single worker, so a stream written
+         * as one frame gets no faster.
+         *
+         * @tparam R The type of the contiguous range that holds a zstd
+         * compressed stream.
+         * @tparam T The type to decompress into.
+         */
+        template<std::ranges::viewable_range R, typename T>
+            requires std::ranges::input_range<R> && std::is_standard_layout_v<T> && std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<R>>>
+                && zstd_decode_stream<R>::contiguous_input
+        class zstd_decode_parallel_view : public std::ranges::view_interface<zstd_decode_parallel_view<R, T>> {
+            R input_;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+            zstd_decode_parameters parameters_;
+            size_t workers_;
+        public:
+            /**
+             * Initialize a new instance of the zstd_decode_parallel_view
+             * class.
+             *
+             * The given input range must comprise a valid zstd compressed
+             * stream. Failure to provide a valid stream will result in a
+             * std::invalid_argument exception.
+             *
+             * @param parameters The zstd decompression parameters. Every
+             * worker uses them, so a workspace isn't allowed and a memory
+             * resource must be thread-safe. The stats_callback gets the
+             * counters of all the workers added together. The
+             * progress_callback runs on the consuming thread as each run
+             * of frames gets handed out.
+             * @param workers The number of worker threads, and so of frame
+             * runs decompressed at once; zero for
+             * std::thread::hardware_concurrency().
+             * @param input the range to decompress.
+             */
+            zstd_decode_parallel_view(zstd_decode_parameters parameters, size_t workers, R&& input)  // NOLINT(cppcoreguidelines-rvalue-reference-param-not-moved)
+                : input_(std::forward<R>(input)), parameters_{ std::move(parameters) }, workers_{ workers == 0 ? std::max(1U, std::thread::hardware_concurrency()) : workers }
+            {
+                if (!parameters_.workspace.empty())
+                {
+                    throw std::invalid_argument("zstd_decode_parallel: A workspace can't be shared between workers.");
+                }
+            }
+
+            zstd_decode_parallel_view(zstd_decode_parallel_view const&) = default;
+            zstd_decode_parallel_view(zstd_decode_parallel_view&&) = default;
+            ~zstd_decode_parallel_view() noexcept = default;
+            auto operator=(zstd_decode_parallel_view const&) -> zstd_decode_parallel_view& = default;
+            auto operator=(zstd_decode_parallel_view&& o) noexcept -> zstd_decode_parallel_view&
+            {
+                parameters_ = std::move(o.parameters_);
+                workers_ = o.workers_;
+                input_ = std::move(std::forward<zstd_decode_parallel_view>(o).input_);
+                return *this;
+            }
+
+            /**
+             * Forward declaration of the zstd_decode_parallel_view
+             * end-of-sequence sentinel.
+             */
+            struct sentinel;
+
+            /**
+             * The iterator for the zstd_decode_parallel_view providing a view
+             * of the decompressed stream.
+             *
+             * Copies share the decompression state, so incrementing one
+             * advances them all.
+             */
+            class iterator
+            {
+            public:
+                using iterator_concept = std::input_iterator_tag;
+                using iterator_category = std::input_iterator_tag;
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+                using input_type = std::remove_cvref_t<std::ranges::range_value_t<R>>;
+
+                /**
+                 * Frames get handed to a worker in runs of at least this many
+                 * compressed bytes so small frames don't each pay for a
+                 * trip through the queue.
+                 */
+                static constexpr size_t run_size{ static_cast<size_t>(256) * 1024 };
+
+                /**
+                 * A run's frame headers get trusted to size its output only up
+                 * to this many times its compressed size. Beyond that, a
+                 * damaged or hostile header could ask for gigabytes, so the
+                 * run streams into a buffer that grows as zstd produces.
+                 */
+                static constexpr size_t max_trusted_ratio{ 256 };
+            private:
+                /**
+                 * Each decompressed run has this many bytes of room ahead of
+                 * it for the start of a value that straddles two runs.
+                 */
+                static constexpr size_t headroom{ sizeof(value_type) };
+
+                /**
+                 * Decompresses a run of frames on whichever worker picks it up.
+                 */
+                using job = std::packaged_task<zstd_buffer(zstd_decompressor const&)>;
+
+                /**
+                 * A run of frames handed to a worker.
+                 */
+                struct pending
+                {
+                    size_t compressed;
+                    std::future<zstd_buffer> decompressed;
+                };
+
+                /**
+                 * The decompression state the iterator copies share.
+                 */
+                struct state
+                {
+                    zstd_decode_parameters parameters; // what the workers get, without the callbacks
+                    zstd_stats_recorder stats; // reports for all the workers
+                    zstd_progress_reporter progress; // reports as the runs come back, on the consuming thread
+                    size_t workers{ 1 };
+                    std::span<uint8_t const> remaining; // compressed bytes not yet handed to a worker
+                    std::deque<pending> in_flight;
+                    zstd_buffer run;
+                    size_t run_pos{ 0 };
+                    value_type value{};
+                    bool at_end{ false };
+                    std::mutex mutex;
+                    std::condition_variable_any queued;
+                    std::deque<job> queue;
+                    std::deque<zstd_decompressor> decompressors; // one per worker, reused for every run it picks up
+                    std::vector<std::jthread> threads; // last, so they stop and get joined before the rest goes away
+
+                    /**
+                     * Initialize a new instance of the state struct.
+                     * @param p The zstd decompression parameters.
+                     * @param w The number of worker threads.
+                     */
+                    state(zstd_decode_parameters const& p, size_t w) : parameters{ p }, stats{ p }, progress{ p }, workers{ w }
+                    {
+                        parameters.stats_callback = nullptr;
+                        parameters.progress_callback = nullptr;
+                    }
+
+                    state(state const&) = delete;
+                    state(state&&) = delete;
+
+                    /**
+                     * Stop the workers and gather their counters, so stats
+                     * reports them once, on the thread the last iterator
+                     * copy goes away on.
+                     */
+                    ~state()
+                    {
+                        threads.clear();
+                        for (auto const& decompress : decompressors)
+                        {
+                            stats.add(decompress.recorder().stats());
+                        }
+                    }
+
+                    auto operator=(state const&) -> state& = delete;
+                    auto operator=(state&&) -> state& = delete;
+                };
+
+                std::shared_ptr<state> state_;
+            public:
+                /**
+                 * Initialize a new instance of the
+                 * zstd_decode_parallel_view::iterator class.
+                 * @param parameters The zstd decompression parameters.
+                 * @param workers The number of worker threads.
+                 * @param begin The start of the input range to decompress.
+                 * @param end The end of the input range.
+                 */
+                iterator(zstd_decode_parameters const& parameters, size_t workers, std::ranges::const_iterator_t<R> begin, std::ranges::const_sentinel_t<R> end)
+                    : state_{ std::make_shared<state>(parameters, workers) }
+                {
+                    state_->remaining = std::span{ reinterpret_cast<uint8_t const*>(std::to_address(begin)), static_cast<size_t>(end - begin) * sizeof(input_type) };
+                    state_->run = zstd_buffer{ parameters.memory_resource };
+                    load_next_value();
+                }
+
+                /**
+                 * Increment the iterator.
+                 * @return The incremented iterator value.
+                 */
+                auto operator++() -> iterator&
+                {
+                    load_next_value();
+                    return *this;
+                }
+
+                /**
+                 * Increment the iterator.
+                 */
+                void operator++(int)
+                {
+                    load_next_value();
+                }
+
+                /**
+                 * Compare the provided iterator for equality.
+                 * @param i The iterator to compare against.
+                 * @return True if the provided iterator shares this one's
+                 * decompression state, and so its position.
+                 */
+                auto equals(const iterator& i) const noexcept -> bool
+                {
+                    return state_ == i.state_;
+                }
+
+                /**
+                 * Compare the provided sentinel for equality.
+                 * @return True if at the end of the decompressed view.
+                 */
+                auto equals(const sentinel&) const noexcept -> bool
+                {
+                    return state_->at_end;
+                }
+
+                /**
+                 * Gets the current decompressed value.
+                 * @return The current decompressed value.
+                 */
+                auto operator*() const -> value_type
+                {
+                    return state_->value;
+                }
+
+                auto operator==(const iterator& other) const noexcept -> bool { return equals(other); }
+                auto operator==(const sentinel& s) const noexcept -> bool { return equals(s); }
+                auto operator!=(const iterator& other) const noexcept -> bool { return !equals(other); }
+                auto operator!=(const sentinel& s) const noexcept -> bool { return !equals(s); }
+
+            private:
+                /**
+                 * Moves to the next decompressed value, waiting on the next
+                 * run of frames as needed.
+                 *
+                 * Will throw std::invalid_argument for a truncated or
+                 * otherwise invalid input range.
+                 */
+                void load_next_value()
+                {
+                    auto& s{ *state_ };
+                    while (s.run.size() - s.run_pos < sizeof(value_type))
+                    {
+                        size_t const carry{ s.run.size() - s.run_pos };
+                        launch_runs();
+                        if (s.in_flight.empty())
+                        {
+                            if (carry > 0)
+                            {
+                                throw std::invalid_argument(std::format("zstd_decode_parallel: Partial type at end of data. Required {} bytes, received {}.", sizeof(value_type), carry));
+                            }
+
+                            s.at_end = true;
+                            return;
+                        }
+
+                        size_t const compressed{ s.in_flight.front().compressed };
+                        zstd_buffer next{ s.in_flight.front().decompressed.get() };
+                        s.in_flight.pop_front();
+                        launch_runs();
+                        if (s.progress.enabled())
+                        {
+                            // a run ends at a frame boundary
+                            s.progress.record(compressed, next.size() - headroom, true, [] { return ZSTD_frameProgression{}; });
+                        }
+
+                        // the start of a value that straddles two runs moves into the headroom
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                        std::copy(s.run.data() + s.run_pos, s.run.data() + s.run.size(), next.data() + (headroom - carry));
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                        s.run = std::move(next);
+                        s.run_pos = headroom - carry;
+                    }
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                    std::memcpy(&s.value, s.run.data() + s.run_pos, sizeof(value_type));
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                    s.run_pos += sizeof(value_type);
+                }
+
+                /**
+                 * Queue runs of frames until every worker has one or the
+                 * input runs out, starting workers as they're needed.
+                 *
+                 * Will throw std::invalid_argument for a truncated or
+                 * otherwise invalid input range.
+                 */
+                void launch_runs()
+                {
+                    auto& s{ *state_ };
+                    while (s.in_flight.size() < s.workers && !s.remaining.empty())
+                    {
+                        size_t size{ 0 };
+                        while (size < run_size && size < s.remaining.size())
+                        {
+                            size_t const frame_size{ ZSTD_findFrameCompressedSize(s.remaining.subspan(size).data(), s.remaining.size() - size) };
+                            if (ZSTD_isError(frame_size))
+                            {
+                                throw std::invalid_argument(std::format("zstd_decode_parallel: Failed to find the end of a frame: {}.", ZSTD_getErrorName(frame_size)));
+                            }
+
+                            size += frame_size;
+                        }
+
+                        if (s.threads.size() <= s.in_flight.size())
+                        {
+                            s.threads.emplace_back(work, std::ref(s), std::cref(s.decompressors.emplace_back(s.parameters, 0, 0)));
+                        }
+
+                        job next{ [parameters{ &s.parameters }, run{ s.remaining.first(size) }](zstd_decompressor const& decompress) { return decompress_run(*parameters, decompress, run); } };
+                        s.in_flight.push_back(pending{ size, next.get_future() });
+                        {
+                            std::scoped_lock const lock{ s.mutex };
+                            s.queue.push_back(std::move(next));
+                        }
+
+                        s.queued.notify_one();
+                        s.remaining = s.remaining.subspan(size);
+                    }
+                }
+
+                /**
+                 * Run queued jobs until the last copy of the iterator goes
+                 * away. Runs on a worker.
+                 * @param stop Set when the last copy goes away.
+                 * @param s The shared state.
+                 * @param decompress The worker's decompressor, reused for
+                 * every run it picks up.
+                 */
+                static void work(std::stop_token const& stop, state& s, zstd_decompressor const& decompress)
+                {
+                    while (true)
+                    {
+                        job next;
+                        {
+                            std::unique_lock lock{ s.mutex };
+                            if (!s.queued.wait(lock, stop, [&s] { return !s.queue.empty(); }))
+                            {
+                                return;
+                            }
+
+                            next = std::move(s.queue.front());
+                            s.queue.pop_front();
+                        }
+
+                        next(decompress); // an exception lands in the job's future
+                    }
+                }
+
+                /**
+                 * Decompress a run of whole frames. Runs on a worker.
+                 * @param parameters The zstd decompression parameters.
+                 * @param decompress The worker's decompressor.
+                 * @param run The compressed frames.
+                 * @return headroom bytes followed by the decompressed bytes.
+                 */
+                static auto decompress_run(zstd_decode_parameters const& parameters, zstd_decompressor const& decompress, std::span<uint8_t const> run) -> zstd_buffer
+                {
+                    zstd_buffer ret{ parameters.memory_resource };
+                    if (unsigned long long const size{ ZSTD_findDecompressedSize(run.data(), run.size()) };
+                        size != ZSTD_CONTENTSIZE_UNKNOWN && size != ZSTD_CONTENTSIZE_ERROR && size <= run.size() * max_trusted_ratio)
+                    {
+                        zstd_check_window(parameters, run, "zstd_decode_parallel");
+                        ret.resize(headroom + static_cast<size_t>(size));
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                        ret.resize(headroom + decompress.decompress_to(run.data(), run.size(), ret.data() + headroom, static_cast<size_t>(size)));
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                        return ret;
+                    }
+
+                    // stream straight into the run's buffer, growing it as zstd fills it
+                    ret.resize(headroom + std::max(run.size() * 4, ZSTD_DStreamOutSize()));
+                    ZSTD_outBuffer out{ ret.data(), ret.size(), headroom };
+                    decompress.in() = ZSTD_inBuffer{ run.data(), run.size(), 0 };
+                    while (true)
+                    {
+                        if (out.pos == out.size)
+                        {
+                            zstd_buffer bigger{ parameters.memory_resource };
+                            bigger.resize(out.size * 2);
+                            std::memcpy(bigger.data(), ret.data(), out.pos);
+                            ret = std::move(bigger);
+                            out.dst = ret.data();
+                            out.size = ret.size();
+                        }
+
+                        bool const done{ decompress.decompress_to(out) };
+                        if (decompress.in().pos == decompress.in().size && out.pos < out.size)
+                        {
+                            if (!done)
+                            {
+                                throw std::invalid_argument("zstd_decode_parallel: Truncated input. Failed decompression at end of input.");
+                            }
+
+                            break;
+                        }
+                    }
+
+                    ret.resize(out.pos);
+                    return ret;
+                }
+            };
+
+            struct sentinel
+            {
+                auto operator==(const sentinel& /*other*/) const -> bool { return true; }
+                auto operator==(const iterator& i) const -> bool { return i.equals(*this); }
+                auto operator!=(const sentinel& /*other*/) const -> bool { return false; }
+                auto operator!=(const iterator& i) const -> bool { return !i.equals(*this); }
+            };
+
+            iterator begin() const { return iterator(parameters_, workers_, std::ranges::begin(input_), std::ranges::end(input_)); }
+
+            /**
+             * Get the number of values the view will produce, if the frame
+             * headers record it, so the caller can reserve space up front.
+             *
+             * @return The number of decompressed values; zero if unknown.
+             */
+            [[nodiscard]] auto reserve_hint() const -> size_t
+            {
+                return zstd_decode_stream<R>::content_size(std::ranges::begin(input_), std::ranges::end(input_)) / sizeof(T);
+            }
+
+            sentinel end() const { return sentinel{}; }
+        };
+
+        /**
+         * Functor that, given a contiguous zstd compressed range, provides a
+         * decompressed view of that range, decompressing frames concurrently.
+         * @tparam T The type to decompress into.
+         */
+        template <typename T>
+        class zstd_decode_parallel_fn : public std::ranges::range_adaptor_closure<zstd_decode_parallel_fn<T>>
+        {
+            zstd_decode_parameters parameters_;
+            size_t workers_;
+        public:
+            explicit zstd_decode_parallel_fn(zstd_decode_parameters parameters = {}, size_t workers = 0) : parameters_{ std::move(parameters) }, workers_{ workers } {}
+            template <std::ranges::viewable_range R>
+            [[nodiscard]] constexpr auto operator()(R&& range) const -> zstd_decode_parallel_view<std::views::all_t<R>, T>
+            {
+                return zstd_decode_parallel_view<std::views::all_t<R>, T>(parameters_, workers_, std::views::all(std::forward<R>(range)));
+            }
+        };
+    }
+}
+
+namespace sph::views
+{
+    /**
+     * A range adaptor that represents view of an underlying contiguous,
+     * multi-frame, zstd compressed sequence after decompressing its frames
+     * concurrently.
+     *
+     * Produces the same values as zstd_decode. Worth it for archives
+     * written as many independent frames, for example by compressing each
+     * record or block with its own zstd_encode view and concatenating the
+     * results.
+     *
+     * Will fail to decompress and throw a std::invalid_argument if the
+     * provided range does not represent a valid zstd compressed stream.
+     *
+     * @tparam T The type to decompress into.
+     * @param workers The number of worker threads, and so of frame runs
+     * decompressed at once; zero for std::thread::hardware_concurrency().
+     * @return A functor that takes a contiguous zstd compressed range and returns a view of the decompressed information.
+     */
+    template<typename T = uint8_t>
+    auto zstd_decode_parallel(size_t workers = 0) -> sph::ranges::views::detail::zstd_decode_parallel_fn<T>
+    {
+        return sph::ranges::views::detail::zstd_decode_parallel_fn<T>{ zstd_decode_parameters{}, workers };
+    }
+
+    /**
+     * A range adaptor that represents view of an underlying contiguous,
+     * multi-frame, zstd compressed sequence after decompressing its frames
+     * concurrently.
+     *
+     * @tparam T The type to decompress into.
+     * @param parameters The zstd decompression parameters. Every worker uses
+     * them, so a workspace isn't allowed and a memory resource must be
+     * thread-safe. The stats_callback gets the counters of all the workers
+     * added together, once, when the last copy of the iterator goes away.
+     * The progress_callback gets the totals so far on the consuming thread
+     * as each run of frames gets handed out.
+     * @param workers The number of worker threads, and so of frame runs
+     * decompressed at once; zero for std::thread::hardware_concurrency().
+     * @return A functor that takes a contiguous zstd compressed range and returns a view of the decompressed information.
+     */
+    template<typename T = uint8_t>
+    auto zstd_decode_parallel(zstd_decode_parameters const& parameters, size_t workers = 0) -> sph::ranges::views::detail::zstd_decode_parallel_fn<T>
+    {
+        return sph::ranges::views::detail::zstd_decode_parallel_fn<T>{ parameters, workers };
+    }
+}
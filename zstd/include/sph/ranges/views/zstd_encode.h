@@ -1,9 +1,17 @@
 #pragma once
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstring>
 #include <format>
+#include <iterator>
+#include <limits>
 #include <ranges>
 #include <stdexcept>
+#include <vector>
+#include <sph/ranges/views/detail/zstd_adaptive_level.h>
 #include <sph/ranges/views/detail/zstd_compress.h>
+#include <sph/ranges/views/detail/zstd_seekable.h>
 
 namespace sph::ranges::views
 {
@@ -18,7 +26,7 @@ namespace sph::ranges::views
             requires std::ranges::input_range<R> && std::is_standard_layout_v<T> && std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<R>>>
         class zstd_encode_view : public std::ranges::view_interface<zstd_encode_view<R, T>> {
             R input_;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
-            int compression_level_;
+            zstd_encode_parameters parameters_;
         public:
             /**
              * Initialize a new instance of the zstd_encode_view class.
@@ -30,12 +38,11 @@ namespace sph::ranges::views
              * get a zstd skippable frame appended to populate the missing
              * bytes.
              *
-             * @param compression_level Value clamped to ZSTD_minCLevel() and
-             * ZSTD_maxCLevel().
+             * @param parameters The zstd compression parameters.
              * @param input the range to decompress.
              */
-            explicit zstd_encode_view(int compression_level, R&& input)  // NOLINT(cppcoreguidelines-rvalue-reference-param-not-moved)
-                : input_(std::forward<R>(input)), compression_level_{ compression_level } {}
+            explicit zstd_encode_view(zstd_encode_parameters const& parameters, R&& input)  // NOLINT(cppcoreguidelines-rvalue-reference-param-not-moved)
+                : input_(std::forward<R>(input)), parameters_{ parameters } {}
 
             zstd_encode_view(zstd_encode_view const&) = default;
             zstd_encode_view(zstd_encode_view&&) = default;
@@ -44,7 +51,7 @@ namespace sph::ranges::views
             auto operator=(zstd_encode_view&& o) noexcept -> zstd_encode_view&
             {
                 // not sure why "= default" doesn't work here...
-				compression_level_ = std::forward<zstd_encode_view>(o).compression_level_;
+				parameters_ = std::forward<zstd_encode_view>(o).parameters_;
                 input_ = std::move(std::forward<zstd_encode_view>(o).input_);
                 return *this;
             }
@@ -69,11 +76,27 @@ namespace sph::ranges::views
                 using difference_type = std::ptrdiff_t;
                 using input_type = std::remove_cvref_t<std::ranges::range_value_t<R>>;
             private:
+                /**
+                 * True if the input range sits in contiguous memory with a
+                 * known length so zstd can read it in place instead of having
+                 * it copied into the compressor's input buffer.
+                 */
+                static constexpr bool contiguous_input{
+                    std::contiguous_iterator<std::ranges::const_iterator_t<R>>
+                    && std::sized_sentinel_for<std::ranges::const_sentinel_t<R>, std::ranges::const_iterator_t<R>> };
                 zstd_compressor compress_;
                 std::ranges::const_iterator_t<R> current_;
                 size_t current_pos_{ 0 };
                 std::ranges::const_sentinel_t<R> end_;
-                value_type value_;
+                /**
+                 * Multibyte values get block copied out of the compressed
+                 * buffer this many bytes' worth at a time.
+                 */
+                static constexpr size_t value_cache_bytes{ 256 };
+                static constexpr size_t value_cache_size{ sizeof(value_type) > 1 ? std::max(static_cast<size_t>(1), value_cache_bytes / sizeof(value_type)) : 1 };
+                std::array<value_type, value_cache_size> values_{};
+                size_t value_index_{ 0 };
+                size_t value_count_{ 0 };
                 // only need skippable_frame_ if sizeof(value_type) > 1
                 struct empty {};
                 using skippable_frame_t = std::conditional_t<sizeof(value_type) == 1, empty, std::optional<std::vector<uint8_t>>>;
@@ -85,6 +108,30 @@ namespace sph::ranges::views
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
+                /**
+                 * The number of uncompressed bytes per frame of a seekable
+                 * stream; zero for a single frame.
+                 */
+                size_t frame_size_{ 0 };
+                size_t frame_remaining_{ std::numeric_limits<size_t>::max() };
+                /**
+                 * The number of uncompressed bytes between flushes; zero for
+                 * no flushes.
+                 */
+                size_t flush_size_{ 0 };
+                size_t flush_remaining_{ std::numeric_limits<size_t>::max() };
+                size_t frame_compressed_{ 0 };
+                size_t frame_decompressed_{ 0 };
+                unsigned long long pledge_remaining_{ ZSTD_CONTENTSIZE_UNKNOWN };
+                std::vector<zstd_seekable_entry> seek_entries_;
+                std::vector<uint8_t> seek_table_;
+                size_t seek_table_pos_{ 0 };
+                zstd_adaptive_level adapt_{ zstd_encode_parameters{} };
+                /**
+                 * True when the adaptive level changed in a single-frame
+                 * stream and the frame has to end for zstd to take it.
+                 */
+                bool level_changed_{ false };
                 bool reading_complete_{ false };
                 bool compressing_complete_{ false };
                 bool at_end_{ false };
@@ -92,19 +139,63 @@ namespace sph::ranges::views
                 /**
                  * Initialize a new instance of the zstd_encode_view::iterator
                  * class.
-                 * @param compression_level Value clamped to ZSTD_minCLevel()
-                 * and ZSTD_maxCLevel(). Zero for default compression (usually
-                 * maps to compression level 3). Higher values compress more.
+                 * @param parameters The zstd compression parameters.
                  * @param begin The start of the input range to compress.
                  * @param end The end of the input range.
+                 * @param size The number of bytes in the input range if known;
+                 * ZSTD_CONTENTSIZE_UNKNOWN otherwise. A known size gets
+                 * pledged to zstd, a frame at a time for a seekable stream,
+                 * and, for contiguous input that fits, compressed in one
+                 * call.
                  */
-                iterator(int compression_level, std::ranges::const_iterator_t<R> begin, std::ranges::const_sentinel_t<R> end)
-                    : compress_{ compression_level }, current_(begin), end_(end)
+                iterator(zstd_encode_parameters const& parameters, std::ranges::const_iterator_t<R> begin, std::ranges::const_sentinel_t<R> end, unsigned long long size = ZSTD_CONTENTSIZE_UNKNOWN)
+                    : compress_{ parameters }, current_(begin), end_(end)
+                    , frame_size_{ std::min(parameters.seekable_frame_size, zstd_seekable_max_frame_size) }
+                    , frame_remaining_{ frame_size_ == 0 ? std::numeric_limits<size_t>::max() : frame_size_ }
+                    , flush_size_{ parameters.flush_size }
+                    , flush_remaining_{ flush_size_ == 0 ? std::numeric_limits<size_t>::max() : flush_size_ }
+                    , pledge_remaining_{ size }
+                    , adapt_{ parameters }
                 {
+                    if (adapt_.enabled())
+                    {
+                        compress_.set_level(adapt_.level());
+                        if (frame_size_ == 0)
+                        {
+                            // a level change ends the frame, so there's no one frame to pledge a size
+                            // for, and compressing in one call would leave nothing to adapt
+                            size = ZSTD_CONTENTSIZE_UNKNOWN;
+                            pledge_remaining_ = size;
+                        }
+                    }
+
+                    if (size != ZSTD_CONTENTSIZE_UNKNOWN)
+                    {
+                        pledge_frame();
+                        if constexpr (contiguous_input)
+                        {
+                            if (size <= frame_remaining_ && compress_.compress_once(reinterpret_cast<uint8_t const*>(std::to_address(current_)), static_cast<size_t>(size)))
+                            {
+                                current_ = std::ranges::next(current_, end_);
+                                reading_complete_ = true;
+                                if (frame_size_ == 0)
+                                {
+                                    compressing_complete_ = true;
+                                }
+                                else
+                                {
+                                    frame_compressed_ = compress_.out_size();
+                                    frame_decompressed_ = static_cast<size_t>(size);
+                                    end_frame();
+                                }
+                            }
+                        }
+                    }
+
                     load_next_value();
                 }
 
-                iterator() : compress_{}, current_{ std::ranges::sentinel_t<R>{} }, end_{}, value_ {} {}
+                iterator() : compress_{}, current_{ std::ranges::sentinel_t<R>{} }, end_{} {}
                 iterator(iterator const&) = default;
                 iterator(iterator&&) = default;
                 ~iterator() = default;
@@ -118,7 +209,7 @@ namespace sph::ranges::views
                  */
                 auto equals(const iterator& i) const noexcept -> bool
                 {
-                    return current_ == i.current_ && compress_.in_pos() == i.compress_.in_pos() && compress_.out_pos() == i.compress_.out_pos();
+                    return current_ == i.current_ && compress_.in_pos() == i.compress_.in_pos() && compress_.out_pos() == i.compress_.out_pos() && value_index_ == i.value_index_;
                 }
 
                 /**
@@ -158,7 +249,7 @@ namespace sph::ranges::views
                  */
                 auto operator*() const -> value_type
                 {
-                    return value_;
+                    return values_[value_index_];
                 }
 
                 auto operator==(const iterator& other) const noexcept -> bool { return equals(other); }
@@ -166,6 +257,64 @@ namespace sph::ranges::views
                 auto operator!=(const iterator& other) const noexcept -> bool { return !equals(other); }
                 auto operator!=(const sentinel& s) const noexcept -> bool { return !equals(s); }
 
+                /**
+                 * Append the current value and every whole value after it
+                 * that is already in the compressed buffer, then move past
+                 * them. Lets a consumer that works in blocks, like
+                 * zstd_encode_async, take the compressed buffer in one copy
+                 * instead of a value at a time.
+                 *
+                 * Must not be at the end.
+                 *
+                 * @param block Gets the values appended.
+                 */
+                void take_values(std::vector<value_type>& block)
+                {
+                    auto& out{ compress_.out() };
+                    size_t const count{ (out.size - out.pos) / sizeof(value_type) };
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                    auto const* const src{ static_cast<uint8_t const*>(out.dst) + out.pos };
+                    if constexpr (sizeof(value_type) == 1)
+                    {
+                        block.push_back(values_[0]);
+                        block.insert(block.end(), reinterpret_cast<value_type const*>(src), reinterpret_cast<value_type const*>(src) + count);
+                    }
+                    else
+                    {
+                        block.insert(block.end(), values_.begin() + static_cast<std::ptrdiff_t>(value_index_), values_.begin() + static_cast<std::ptrdiff_t>(value_count_));
+                        value_index_ = value_count_;
+                        if (!skippable_frame_)
+                        {
+                            size_t const size{ block.size() };
+                            block.resize(size + count);
+                            std::memcpy(block.data() + size, src, count * sizeof(value_type));
+                        }
+                    }
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+                    if constexpr (sizeof(value_type) == 1)
+                    {
+                        out.pos += count;
+                    }
+                    else if (!skippable_frame_)
+                    {
+                        out.pos += count * sizeof(value_type);
+                    }
+
+                    load_next_value();
+                }
+
+                /**
+                 * @return The counters for the stream so far; zero without
+                 * SPH_ZSTD_STATS. Shared with copies of the iterator.
+                 */
+                [[nodiscard]] auto stats() const -> zstd_stats const& { return compress_.recorder().stats(); }
+
             private:
                 /**
 				 * Get a skippable frame that can be appended to the end of a compressed buffer to make it a multiple of value_type elements.
@@ -199,17 +348,49 @@ namespace sph::ranges::views
                 }
 
                 /**
-                 * Sets _value to the next compressed value.
+                 * Moves to the next compressed value.
+                 *
+                 * Multibyte values get block copied from the compressed
+                 * buffer into values_ so most increments just bump
+                 * value_index_. Only a value that straddles two compressed
+                 * buffers or the end of the stream gets assembled a byte at a
+                 * time.
                  */
                 void load_next_value()
                 {
                     if constexpr(sizeof(value_type) > 1)
                     {
+                        if (++value_index_ < value_count_)
+                        {
+                            return;
+                        }
+
+                        value_index_ = 0;
+                        value_count_ = 1;
+                        if (!skippable_frame_)
+                        {
+                            auto& out{ compress_.out() };
+                            if (size_t const count{ std::min((out.size - out.pos) / sizeof(value_type), values_.size()) }; count > 0)
+                            {
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                                std::memcpy(reinterpret_cast<uint8_t*>(values_.data()), static_cast<uint8_t const*>(out.dst) + out.pos, count * sizeof(value_type));
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                                out.pos += count * sizeof(value_type);
+                                value_count_ = count;
+                                return;
+                            }
+                        }
+
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage-in-container"
 #endif
-                        std::span<uint8_t, sizeof(value_type)> value_span{ reinterpret_cast<uint8_t*>(&value_), sizeof(value_type) };
+                        std::span<uint8_t, sizeof(value_type)> value_span{ reinterpret_cast<uint8_t*>(values_.data()), sizeof(value_type) };
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
@@ -296,7 +477,7 @@ namespace sph::ranges::views
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
 #endif
-                        value_ = static_cast<value_type*>(compress_.out().dst)[compress_.out().pos];
+                        values_[0] = static_cast<value_type*>(compress_.out().dst)[compress_.out().pos];
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
@@ -310,15 +491,16 @@ namespace sph::ranges::views
                  */
                 auto load_next_out() -> bool
                 {
+                    auto const refilling{ compress_.recorder().refilling() };
                     if (compressing_complete_)
                     {
-                        return false;
+                        return load_seek_table_out();
                     }
 
-                    if (compress_.in().pos < compress_.in().size)
+                    if (compress_.in().pos < compress_.in().size || frame_remaining_ == 0 || flush_remaining_ == 0 || level_changed_)
                     {
-                        // not done processing the in buffer.
-                        compressing_complete_ = compress_(reading_complete_ ? ZSTD_e_end : ZSTD_e_continue);
+                        // not done processing the in buffer, ending a frame, or flushing.
+                        compress(end_directive());
                         return true;
                     }
 
@@ -333,46 +515,271 @@ namespace sph::ranges::views
 	                            return false;
                             }
 
-                            compressing_complete_ = compress_(ZSTD_e_end);
+                            if (frame_decompressed_ == 0 && !seek_entries_.empty())
+                            {
+                                // the input ended right at a seekable frame boundary
+                                finish();
+                                return load_seek_table_out();
+                            }
+
+                            compress(ZSTD_e_end);
                             return true;
                         }
 
                         // load_next_in() can set reading_complete_ to true.
-                        compressing_complete_ = compress_(reading_complete_ ? ZSTD_e_end : ZSTD_e_continue);
+                        compress(end_directive());
                     }
                     else
                     {
-                        compressing_complete_ = compress_(ZSTD_e_end);
+                        compress(ZSTD_e_end);
+                    }
+
+                    if (compressing_complete_ && compress_.out_size() == 0)
+                    {
+                        return load_seek_table_out();
+                    }
+
+                    return true;
+                }
+
+                /**
+                 * @return ZSTD_e_end at the end of the input, of a seekable
+                 * frame, or of a frame ended for a new level; ZSTD_e_flush at
+                 * a flush point; ZSTD_e_continue otherwise.
+                 */
+                [[nodiscard]] auto end_directive() const -> ZSTD_EndDirective
+                {
+                    if (reading_complete_ || frame_remaining_ == 0 || level_changed_)
+                    {
+                        return ZSTD_e_end;
                     }
 
-                    return !(compressing_complete_ && compress_.out_size() == 0);
+                    return flush_remaining_ == 0 ? ZSTD_e_flush : ZSTD_e_continue;
+                }
+
+                /**
+                 * Run the compressor, keeping track of flush points and the
+                 * frames of a seekable stream.
+                 * @param mode ZSTD_e_continue if there will be more input
+                 * data for the frame; ZSTD_e_flush at a flush point;
+                 * ZSTD_e_end if there won't be more input data for the frame.
+                 */
+                void compress(ZSTD_EndDirective mode)
+                {
+                    bool const frame_complete{ adapt_.enabled() ? compress_adapting(mode) : compress_(mode) };
+                    if (mode == ZSTD_e_flush)
+                    {
+                        frame_compressed_ += compress_.out_size();
+                        if (frame_complete)
+                        {
+                            flush_remaining_ = flush_size_;
+                        }
+
+                        return;
+                    }
+
+                    if (frame_complete && flush_size_ != 0)
+                    {
+                        flush_remaining_ = flush_size_;
+                    }
+
+                    if (frame_size_ == 0)
+                    {
+                        if (frame_complete && level_changed_)
+                        {
+                            // the frame ended so zstd takes the new level; the next one picks up from here
+                            level_changed_ = false;
+                            compressing_complete_ = reading_complete_ && compress_.in().pos == compress_.in().size;
+                            return;
+                        }
+
+                        compressing_complete_ = frame_complete;
+                        return;
+                    }
+
+                    frame_compressed_ += compress_.out_size();
+                    if (frame_complete)
+                    {
+                        end_frame();
+                    }
+                }
+
+                /**
+                 * Run the compressor, timing it for the adaptive level.
+                 * @param mode The end directive.
+                 * @return True if the frame is complete.
+                 */
+                auto compress_adapting(ZSTD_EndDirective mode) -> bool
+                {
+                    size_t const in_pos{ compress_.in().pos };
+                    auto const start{ zstd_adaptive_level::clock::now() };
+                    bool const ret{ compress_(mode) };
+                    if (adapt_.record(compress_.in().pos - in_pos, zstd_adaptive_level::clock::now() - start))
+                    {
+                        compress_.set_level(adapt_.level());
+                        level_changed_ = frame_size_ == 0;
+                    }
+
+                    return ret;
+                }
+
+                /**
+                 * Record the seek table entry for the seekable frame that
+                 * just ended and start on the next one.
+                 */
+                void end_frame()
+                {
+                    if (seek_entries_.size() == zstd_seekable_max_frames)
+                    {
+                        throw std::runtime_error(std::format("zstd_encode: A seekable stream can't hold more than {} frames.", zstd_seekable_max_frames));
+                    }
+
+                    seek_entries_.push_back(zstd_seekable_entry{ static_cast<uint32_t>(frame_compressed_), static_cast<uint32_t>(frame_decompressed_) });
+                    frame_compressed_ = 0;
+                    frame_decompressed_ = 0;
+                    frame_remaining_ = frame_size_;
+                    if (reading_complete_)
+                    {
+                        finish();
+                    }
+                    else
+                    {
+                        pledge_frame();
+                    }
+                }
+
+                /**
+                 * Mark compression complete and, for a seekable stream, build
+                 * the seek table to hand out after the frames.
+                 */
+                void finish()
+                {
+                    compressing_complete_ = true;
+                    if (frame_size_ != 0)
+                    {
+                        seek_table_ = zstd_seek_table(seek_entries_, sizeof(value_type));
+                    }
+                }
+
+                /**
+                 * If the total input size is known, pledge the size of the
+                 * next frame to zstd.
+                 */
+                void pledge_frame()
+                {
+                    if (pledge_remaining_ == ZSTD_CONTENTSIZE_UNKNOWN)
+                    {
+                        return;
+                    }
+
+                    unsigned long long const size{ frame_size_ == 0 ? pledge_remaining_ : std::min(pledge_remaining_, static_cast<unsigned long long>(frame_size_)) };
+                    compress_.pledge(size);
+                    pledge_remaining_ -= size;
+                }
+
+                /**
+                 * Put the next part of the seek table into the compressor's
+                 * out() buffer.
+                 * @return True if there was more seek table; false otherwise.
+                 */
+                auto load_seek_table_out() -> bool
+                {
+                    size_t const size{ std::min(seek_table_.size() - seek_table_pos_, compress_.out_max_size()) };
+                    if (size == 0)
+                    {
+                        return false;
+                    }
+
+                    auto& out{ compress_.out() };
+                    std::ranges::copy(std::span{ seek_table_ }.subspan(seek_table_pos_, size), static_cast<uint8_t*>(out.dst));
+                    seek_table_pos_ += size;
+                    out.pos = 0;
+                    out.size = size;
+                    return true;
+                }
+
+                /**
+                 * Account for bytes loaded into the compressor's in() buffer.
+                 * @param size The number of bytes loaded.
+                 */
+                void loaded_in(size_t size)
+                {
+                    frame_decompressed_ += size;
+                    if (frame_size_ != 0)
+                    {
+                        frame_remaining_ -= size;
+                    }
+
+                    if (flush_size_ != 0)
+                    {
+                        flush_remaining_ -= size;
+                    }
                 }
 
                 /**
                  * Load the next chunk into the buffer the compressor works on.
+                 *
+                 * For contiguous input, the compressor's in() buffer gets
+                 * pointed directly at the input range. The chunks are the
+                 * same size as the copied chunks so the compressed output
+                 * doesn't depend on the shape of the input range.
+                 *
+                 * A chunk never crosses the end of a seekable frame or a
+                 * flush point.
+                 *
                  * @return True if not at end; false otherwise.
                  */
                 auto load_next_in() -> bool
                 {
+                    auto const staging{ compress_.recorder().staging() };
                     if (current_ == end_)
                     {
                         reading_complete_ = true;
                         return false;
                     }
 
+                    if constexpr (contiguous_input)
+                    {
+                        size_t const remaining{ (static_cast<size_t>(end_ - current_) * sizeof(input_type)) - current_pos_ };
+                        size_t const size{ std::min({ remaining, compress_.in_max_size(), frame_remaining_, flush_remaining_ }) };
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                        compress_.in() = ZSTD_inBuffer{ reinterpret_cast<uint8_t const*>(std::to_address(current_)) + current_pos_, size, 0 };
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                        current_pos_ += size;
+                        current_ += static_cast<std::iter_difference_t<std::ranges::const_iterator_t<R>>>(current_pos_ / sizeof(input_type));
+                        current_pos_ %= sizeof(input_type);
+                        if (size == remaining && size < compress_.in_max_size())
+                        {
+                            reading_complete_ = true;
+                        }
+
+                        loaded_in(size);
+                        return true;
+                    }
+
+                    size_t const max_size{ std::min({ compress_.in_max_size(), frame_remaining_, flush_remaining_ }) };
                     size_t i{ 0 };
                     while (true)
                     {
+                        // copy the value out first; ranges that make values on the fly, like generators, hand out temporaries
+                        input_type const value{ *current_ };
+                        size_t const count{ std::min(sizeof(input_type) - current_pos_, max_size - i) };
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
 #endif
-                        compress_.in_src()[i] = reinterpret_cast<uint8_t const*>(&*current_)[current_pos_++];
+                        std::memcpy(compress_.in_src() + i, reinterpret_cast<uint8_t const*>(&value) + current_pos_, count);
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
-                        ++i;
-                        if (i == compress_.in_max_size())
+                        i += count;
+                        current_pos_ += count;
+                        if (i == max_size)
                         {
                             if (current_pos_ == sizeof(input_type))
                             {
@@ -382,6 +789,7 @@ namespace sph::ranges::views
 
                             compress_.in().size = i;
                             compress_.in().pos = 0;
+                            loaded_in(i);
                             return true;
                         }
 
@@ -393,6 +801,7 @@ namespace sph::ranges::views
                                 reading_complete_ = true;
                                 compress_.in().size = i;
                                 compress_.in().pos = 0;
+                                loaded_in(i);
                                 if (i == 0)
                                 {
                                     return false;
@@ -415,7 +824,17 @@ namespace sph::ranges::views
                 auto operator!=(const iterator& i) const noexcept -> bool { return !i.equals(*this); }
             };
 
-            iterator begin() const { return iterator(compression_level_, std::ranges::begin(input_), std::ranges::end(input_)); }
+            iterator begin() const
+            {
+                if constexpr (std::ranges::sized_range<R const>)
+                {
+                    return iterator(parameters_, std::ranges::begin(input_), std::ranges::end(input_), static_cast<unsigned long long>(std::ranges::size(input_)) * sizeof(std::remove_cvref_t<std::ranges::range_value_t<R>>));
+                }
+                else
+                {
+                    return iterator(parameters_, std::ranges::begin(input_), std::ranges::end(input_));
+                }
+            }
 
             sentinel end() const { return sentinel{}; }
         };
@@ -430,13 +849,13 @@ namespace sph::ranges::views
         template <typename T>
         class zstd_encode_fn : public std::ranges::range_adaptor_closure<zstd_encode_fn<T>>
         {
-            int compression_level_;
+            zstd_encode_parameters parameters_;
         public:
-            explicit zstd_encode_fn(int compression_level) : compression_level_{compression_level}{}
+            explicit zstd_encode_fn(zstd_encode_parameters const& parameters) : parameters_{ parameters }{}
             template <std::ranges::viewable_range R>
             [[nodiscard]] constexpr auto operator()(R&& range) const -> zstd_encode_view<std::views::all_t<R>, T>
             {
-                return zstd_encode_view<std::views::all_t<R>, T>(compression_level_, std::views::all(std::forward<R>(range)));
+                return zstd_encode_view<std::views::all_t<R>, T>(parameters_, std::views::all(std::forward<R>(range)));
             }
         };
     }
@@ -474,6 +893,35 @@ namespace sph::views
 	template<typename T = uint8_t>
     auto zstd_encode(int compression_level = 0) -> sph::ranges::views::detail::zstd_encode_fn<T>
     {
-        return sph::ranges::views::detail::zstd_encode_fn<T>{compression_level};
+        zstd_encode_parameters parameters{};
+        parameters.compression_level = compression_level;
+        return sph::ranges::views::detail::zstd_encode_fn<T>{parameters};
+    }
+
+    /**
+     * A range adaptor that represents view of an underlying sequence after
+     * applying zstd compression to each element.
+     *
+     * Takes the full set of compression parameters, for example to compress
+     * on multiple threads:
+     *
+     * ```c++
+     * sph::zstd_encode_parameters parameters{};
+     * parameters.compression_level = 19;
+     * parameters.workers = 8;
+     * auto compressed{ uncompressed | sph::views::zstd_encode(parameters) | std::ranges::to<std::vector>() };
+     * ```
+     *
+     * With zero workers, the output is identical to the output of
+     * zstd_encode(parameters.compression_level).
+     *
+     * @tparam T The type to compress into. Defaults to uint8_t. Larger types may end up with a zstd skippable frame as padding.
+     * @param parameters The zstd compression parameters.
+     * @return a functor that takes a range and returns a zstd compressed view of that range.
+     */
+    template<typename T = uint8_t>
+    auto zstd_encode(zstd_encode_parameters const& parameters) -> sph::ranges::views::detail::zstd_encode_fn<T>
+    {
+        return sph::ranges::views::detail::zstd_encode_fn<T>{parameters};
     }
 }
@@ -0,0 +1,234 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <sph/ranges/views/detail/zstd_compress.h>
+#include <sph/ranges/views/detail/zstd_decompress.h>
+
+namespace sph::ranges::views::detail
+{
+    /**
+     * True if the range sits in contiguous memory with a known length so
+     * zstd can read it in place.
+     */
+    template<typename R>
+    concept zstd_contiguous_input = std::ranges::contiguous_range<R> && std::ranges::sized_range<R>;
+
+    /**
+     * Copy the next chunk of the input range into a staging input buffer.
+     *
+     * Values get copied out of the range before their bytes get copied into
+     * the buffer, so ranges that produce values on the fly work too.
+     *
+     * @param in The staging buffer. Gets pos=0 and size set to the number of
+     * bytes copied.
+     * @param in_max_size The size of the staging buffer.
+     * @param current The position in the input range. Gets advanced.
+     * @param end The end of the input range.
+     * @param current_pos The number of bytes of *current already copied.
+     * Gets updated.
+     */
+    template<std::input_iterator I, std::sentinel_for<I> S>
+    void zstd_stage_in(ZSTD_inBuffer& in, size_t in_max_size, I& current, S const& end, size_t& current_pos)
+    {
+        auto* const dst{ const_cast<uint8_t*>(static_cast<uint8_t const*>(in.src)) };
+        size_t i{ 0 };
+        while (i < in_max_size && current != end)
+        {
+            std::remove_cvref_t<std::iter_value_t<I>> const value{ *current };
+            size_t const count{ std::min(sizeof(value) - current_pos, in_max_size - i) };
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+            std::memcpy(dst + i, reinterpret_cast<uint8_t const*>(&value) + current_pos, count);
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+            i += count;
+            current_pos += count;
+            if (current_pos == sizeof(value))
+            {
+                ++current;
+                current_pos = 0;
+            }
+        }
+
+        in.size = i;
+        in.pos = 0;
+    }
+}
+
+namespace sph
+{
+    /**
+     * Compress a range straight into memory owned by the caller.
+     *
+     * Unlike the zstd_encode view there is no iterator and no output
+     * staging buffer; zstd writes directly into the given span. Contiguous
+     * input doesn't get staged either and gets compressed in a single call.
+     * Other input gets copied through a staging buffer of in_buffer_size
+     * bytes, by default ZSTD_CStreamInSize().
+     *
+     * The compressed bytes may differ from what the zstd_encode view
+     * produces for the same input, but decompress the same. The output is
+     * always a single frame: the parameters that shape a zstd_encode view's
+     * output, like seekable_frame_size, flush_size, and the adaptive level,
+     * don't apply.
+     *
+     * Size the output with ZSTD_compressBound() to never run out of room.
+     *
+     * @tparam R The type of the range to compress.
+     * @param input The range to compress.
+     * @param out Where to put the compressed bytes. Throws
+     * std::invalid_argument if the compressed bytes don't fit.
+     * @param parameters The zstd compression parameters.
+     * @return The part of out holding the compressed bytes.
+     */
+    template<std::ranges::input_range R>
+        requires std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<R>>>
+    auto zstd_encode_into(R&& input, std::span<uint8_t> out, zstd_encode_parameters const& parameters = {}) -> std::span<uint8_t>
+    {
+        using input_type = std::remove_cvref_t<std::ranges::range_value_t<R>>;
+        if constexpr (ranges::views::detail::zstd_contiguous_input<R>)
+        {
+            ranges::views::detail::zstd_compressor const compress{ parameters, 0, 0 };
+            return out.first(compress.compress_to(reinterpret_cast<uint8_t const*>(std::ranges::data(input)), std::ranges::size(input) * sizeof(input_type), out.data(), out.size()));
+        }
+        else
+        {
+            ranges::views::detail::zstd_compressor const compress{ parameters, ranges::views::detail::zstd_staging_size(parameters.in_buffer_size, ZSTD_CStreamInSize()), 0 };
+            if constexpr (std::ranges::sized_range<R>)
+            {
+                compress.pledge(std::ranges::size(input) * sizeof(input_type));
+            }
+
+            ZSTD_outBuffer o{ out.data(), out.size(), 0 };
+            auto current{ std::ranges::begin(input) };
+            auto const end{ std::ranges::end(input) };
+            size_t current_pos{ 0 };
+            while (true)
+            {
+                if (compress.in().pos >= compress.in().size)
+                {
+                    ranges::views::detail::zstd_stage_in(compress.in(), compress.in_max_size(), current, end, current_pos);
+                }
+
+                bool const last{ current == end };
+                size_t const remaining{ compress.compress_to(o, last ? ZSTD_e_end : ZSTD_e_continue) };
+                if (last && remaining == 0)
+                {
+                    return out.first(o.pos);
+                }
+
+                if (o.pos == o.size && (last || compress.in().pos < compress.in().size))
+                {
+                    throw std::invalid_argument(std::format("zstd_encode_into: Output too small. Compressed to more than {} bytes.", out.size()));
+                }
+            }
+        }
+    }
+
+    /**
+     * Decompress a range straight into memory owned by the caller.
+     *
+     * Unlike the zstd_decode view there is no iterator and no output
+     * staging buffer; zstd writes directly into the given span. Contiguous
+     * input doesn't get staged either and gets decompressed in a single
+     * call. Other input gets copied through a staging buffer of
+     * in_buffer_size bytes, by default ZSTD_DStreamInSize().
+     *
+     * Size the output with ZSTD_findDecompressedSize() when the frames
+     * record their content size.
+     *
+     * @tparam R The type of the range that holds a zstd compressed stream.
+     * @tparam T The type to decompress into. Throws std::invalid_argument if
+     * the decompressed bytes aren't a whole number of them.
+     * @param input The range that holds a zstd compressed stream. May hold
+     * multiple frames. Throws std::invalid_argument if it isn't valid.
+     * @param out Where to put the decompressed values. Throws
+     * std::invalid_argument if the decompressed values don't fit.
+     * @param parameters The zstd decompression parameters.
+     * @return The part of out holding the decompressed values.
+     */
+    template<std::ranges::input_range R, typename T>
+        requires std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<R>>> && std::is_standard_layout_v<T>
+    auto zstd_decode_into(R&& input, std::span<T> out, zstd_decode_parameters const& parameters = {}) -> std::span<T>
+    {
+        using input_type = std::remove_cvref_t<std::ranges::range_value_t<R>>;
+        auto* const dst{ reinterpret_cast<uint8_t*>(out.data()) };
+        size_t size{ 0 };
+        if constexpr (ranges::views::detail::zstd_contiguous_input<R>)
+        {
+            if (std::ranges::empty(input))
+            {
+                return out.first(0);
+            }
+
+            ranges::views::detail::zstd_decompressor const decompress{ parameters, 0, 0 };
+            size = decompress.decompress_to(reinterpret_cast<uint8_t const*>(std::ranges::data(input)), std::ranges::size(input) * sizeof(input_type), dst, out.size_bytes());
+        }
+        else
+        {
+            ranges::views::detail::zstd_decompressor const decompress{ parameters, ranges::views::detail::zstd_staging_size(parameters.in_buffer_size, ZSTD_DStreamInSize()), 0 };
+            ZSTD_outBuffer o{ dst, out.size_bytes(), 0 };
+            auto current{ std::ranges::begin(input) };
+            auto const end{ std::ranges::end(input) };
+            size_t current_pos{ 0 };
+            bool done{ true };
+
+            // once out is full, keep decompressing into a single spare byte to tell a full output from one too small
+            auto const decompress_past_end{ [&decompress, &o]() -> bool
+            {
+                uint8_t extra{ 0 };
+                ZSTD_outBuffer probe{ &extra, 1, 0 };
+                bool const ret{ decompress.decompress_to(probe) };
+                if (probe.pos != 0)
+                {
+                    throw std::invalid_argument(std::format("zstd_decode_into: Output too small. Decompressed to more than {} bytes.", o.size));
+                }
+
+                return ret;
+            } };
+            while (true)
+            {
+                if (decompress.in().pos >= decompress.in().size)
+                {
+                    if (current == end)
+                    {
+                        break;
+                    }
+
+                    ranges::views::detail::zstd_stage_in(decompress.in(), decompress.in_max_size(), current, end, current_pos);
+                }
+
+                done = o.pos < o.size ? decompress.decompress_to(o) : decompress_past_end();
+            }
+
+            if (!done && o.pos == o.size)
+            {
+                done = decompress_past_end();
+            }
+
+            if (!done)
+            {
+                throw std::invalid_argument("zstd_decode_into: Compressed input ends in the middle of a frame.");
+            }
+
+            size = o.pos;
+        }
+
+        if (size % sizeof(T) != 0)
+        {
+            throw std::invalid_argument(std::format("zstd_decode_into: Decompressed {} bytes, not a whole number of {} byte values.", size, sizeof(T)));
+        }
+
+        return out.first(size / sizeof(T));
+    }
+}
@@ -0,0 +1,299 @@
+#pragma once
+#include <algorithm>
+#include <compare>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include <sph/ranges/views/detail/zstd_decode_stream.h>
+#include <sph/ranges/views/detail/zstd_seekable.h>
+
+namespace sph::ranges::views
+{
+    namespace detail
+    {
+        /**
+         * Provides a random access view of an underlying zstd compressed
+         * sequence in the zstd contrib seekable format, as written by
+         * zstd_encode with zstd_encode_parameters::seekable_frame_size set.
+         *
+         * The seek table gets read when the view is made. Reading a value
+         * decompresses only the frame holding it. The last frame decompressed
+         * stays cached so reading nearby values is cheap.
+         *
+         * The view and its copies share one decompression context and frame
+         * cache, so they must not be read from multiple threads at once.
+         *
+         * @tparam R The type of the contiguous range that holds the seekable
+         * zstd compressed stream.
+         * @tparam T The type to decompress into.
+         */
+        template<std::ranges::viewable_range R, typename T>
+            requires std::ranges::input_range<R> && std::is_standard_layout_v<T> && std::is_standard_layout_v<std::remove_cvref_t<std::ranges::range_value_t<R>>>
+                && zstd_decode_stream<R>::contiguous_input
+        class zstd_seekable_decode_view : public std::ranges::view_interface<zstd_seekable_decode_view<R, T>> {
+            using input_type = std::remove_cvref_t<std::ranges::range_value_t<R>>;
+
+            /**
+             * The seek table and the decompression state the view, its
+             * copies, and their iterators share.
+             */
+            struct state
+            {
+                zstd_decode_parameters parameters;
+                zstd_decompressor decompress;
+                std::span<uint8_t const> input;
+                std::vector<zstd_seekable_frame> frames;
+                size_t size{ 0 };
+                size_t loaded{ std::numeric_limits<size_t>::max() };
+                zstd_buffer frame;
+
+                explicit state(zstd_decode_parameters const& p) : parameters{ p }, decompress{ p, 0, 0 }, frame{ p.memory_resource } {}
+
+                /**
+                 * Get the value at the given index, decompressing the frames
+                 * that hold it as needed.
+                 * @param index The index of the value. Must be less than
+                 * size / sizeof(T).
+                 * @return The value.
+                 */
+                auto value_at(size_t index) -> T
+                {
+                    T ret{};
+                    auto* const dst{ reinterpret_cast<uint8_t*>(&ret) };
+                    size_t offset{ index * sizeof(T) };
+                    size_t copied{ 0 };
+                    while (copied < sizeof(T))
+                    {
+                        auto const& f{ load(offset) };
+                        size_t const count{ std::min(sizeof(T) - copied, f.decompressed_offset + f.decompressed_size - offset) };
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                        std::memcpy(dst + copied, frame.data() + (offset - f.decompressed_offset), count);
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+                        copied += count;
+                        offset += count;
+                    }
+
+                    return ret;
+                }
+
+            private:
+                /**
+                 * Make sure the frame holding the given decompressed offset
+                 * is the one in the frame cache.
+                 *
+                 * Will throw std::invalid_argument if the frame needs a
+                 * window bigger than window_log_max or doesn't decompress to
+                 * what the seek table says.
+                 *
+                 * @param offset The decompressed offset.
+                 * @return The frame.
+                 */
+                auto load(size_t offset) -> zstd_seekable_frame const&
+                {
+                    auto const it{ std::ranges::upper_bound(frames, offset, {}, &zstd_seekable_frame::decompressed_offset) };
+                    auto const index{ static_cast<size_t>(std::ranges::distance(frames.begin(), it)) - 1 };
+                    auto const& ret{ *std::ranges::prev(it) };
+                    if (index != loaded)
+                    {
+                        loaded = std::numeric_limits<size_t>::max();
+                        auto const compressed{ input.subspan(ret.compressed_offset, ret.compressed_size) };
+                        zstd_check_window(parameters, compressed, "zstd_seekable_decode");
+                        frame.resize(ret.decompressed_size);
+                        if (size_t const decompressed_size{ decompress.decompress_to(compressed.data(), compressed.size(), frame.data(), frame.size()) }; decompressed_size != ret.decompressed_size)
+                        {
+                            throw std::invalid_argument(std::format("zstd_seekable_decode: Frame {} decompressed to {} bytes, the seek table says {}.", index, decompressed_size, ret.decompressed_size));
+                        }
+
+                        loaded = index;
+                    }
+
+                    return ret;
+                }
+            };
+
+            R input_;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+            std::shared_ptr<state> state_;
+        public:
+            /**
+             * Initialize a new instance of the zstd_seekable_decode_view
+             * class.
+             *
+             * Reads the seek table. Throws std::invalid_argument if the input
+             * range doesn't end with a valid one or the frames don't
+             * decompress to a whole number of T.
+             *
+             * @param parameters The zstd decompression parameters.
+             * @param input the range to decompress.
+             */
+            zstd_seekable_decode_view(zstd_decode_parameters const& parameters, R&& input)  // NOLINT(cppcoreguidelines-rvalue-reference-param-not-moved)
+                : input_(std::forward<R>(input))
+                , state_{ parameters.memory_resource == nullptr
+                    ? std::make_shared<state>(parameters)
+                    : std::allocate_shared<state>(std::pmr::polymorphic_allocator<state>{ parameters.memory_resource }, parameters) }
+            {
+                state_->input = bytes();
+                state_->frames = zstd_read_seek_table(state_->input);
+                if (!state_->frames.empty())
+                {
+                    state_->size = state_->frames.back().decompressed_offset + state_->frames.back().decompressed_size;
+                }
+
+                if (state_->size % sizeof(T) != 0)
+                {
+                    throw std::invalid_argument(std::format("zstd_seekable_decode: Partial type at end of data. Required {} bytes, received {}.", sizeof(T), state_->size % sizeof(T)));
+                }
+            }
+
+            zstd_seekable_decode_view(zstd_seekable_decode_view const&) = default;
+            zstd_seekable_decode_view(zstd_seekable_decode_view&&) = default;
+            ~zstd_seekable_decode_view() noexcept = default;
+            auto operator=(zstd_seekable_decode_view const&) -> zstd_seekable_decode_view& = default;
+            auto operator=(zstd_seekable_decode_view&& o) noexcept -> zstd_seekable_decode_view&
+            {
+                state_ = std::move(o.state_);
+                input_ = std::move(std::forward<zstd_seekable_decode_view>(o).input_);
+                return *this;
+            }
+
+            /**
+             * The random access iterator for the zstd_seekable_decode_view.
+             *
+             * Dereferencing decompresses the frame holding the value if it
+             * isn't the cached one.
+             */
+            class iterator
+            {
+            public:
+                using iterator_concept = std::random_access_iterator_tag;
+                using iterator_category = std::input_iterator_tag;
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+            private:
+                std::shared_ptr<state> state_;
+                difference_type index_{ 0 };
+            public:
+                iterator() = default;
+
+                /**
+                 * Initialize a new instance of the
+                 * zstd_seekable_decode_view::iterator class.
+                 * @param s The decompression state.
+                 * @param index The index of the value the iterator is on.
+                 */
+                iterator(std::shared_ptr<state> s, difference_type index) : state_{ std::move(s) }, index_{ index } {}
+
+                /**
+                 * Gets the current decompressed value.
+                 * @return The current decompressed value.
+                 */
+                auto operator*() const -> value_type { return state_->value_at(static_cast<size_t>(index_)); }
+                auto operator[](difference_type n) const -> value_type { return state_->value_at(static_cast<size_t>(index_ + n)); }
+
+                auto operator++() -> iterator& { ++index_; return *this; }
+                auto operator++(int) -> iterator { auto ret{ *this }; ++index_; return ret; }
+                auto operator--() -> iterator& { --index_; return *this; }
+                auto operator--(int) -> iterator { auto ret{ *this }; --index_; return ret; }
+                auto operator+=(difference_type n) -> iterator& { index_ += n; return *this; }
+                auto operator-=(difference_type n) -> iterator& { index_ -= n; return *this; }
+                friend auto operator+(iterator i, difference_type n) -> iterator { i += n; return i; }
+                friend auto operator+(difference_type n, iterator i) -> iterator { i += n; return i; }
+                friend auto operator-(iterator i, difference_type n) -> iterator { i -= n; return i; }
+                friend auto operator-(iterator const& a, iterator const& b) -> difference_type { return a.index_ - b.index_; }
+
+                auto operator==(const iterator& other) const noexcept -> bool { return index_ == other.index_; }
+                auto operator<=>(const iterator& other) const noexcept -> std::strong_ordering { return index_ <=> other.index_; }
+            };
+
+            iterator begin() const
+            {
+                state_->input = bytes();
+                return iterator(state_, 0);
+            }
+
+            iterator end() const
+            {
+                state_->input = bytes();
+                return iterator(state_, static_cast<std::ptrdiff_t>(size()));
+            }
+
+            /**
+             * @return The number of values the view produces.
+             */
+            [[nodiscard]] auto size() const -> size_t { return state_->size / sizeof(T); }
+
+            /**
+             * @return The number of independently decompressible frames.
+             */
+            [[nodiscard]] auto frame_count() const -> size_t { return state_->frames.size(); }
+
+        private:
+            /**
+             * @return The compressed input as bytes.
+             */
+            [[nodiscard]] auto bytes() const -> std::span<uint8_t const>
+            {
+                return { reinterpret_cast<uint8_t const*>(std::to_address(std::ranges::cbegin(input_))), static_cast<size_t>(std::ranges::cend(input_) - std::ranges::cbegin(input_)) * sizeof(input_type) };
+            }
+        };
+
+        /**
+         * Functor that, given a seekable zstd compressed range, provides a
+         * random access decompressed view of that range.
+         * @tparam T The type to decompress into.
+         */
+        template <typename T>
+        class zstd_seekable_decode_fn : public std::ranges::range_adaptor_closure<zstd_seekable_decode_fn<T>>
+        {
+            zstd_decode_parameters parameters_;
+        public:
+            explicit zstd_seekable_decode_fn(zstd_decode_parameters parameters = {}) : parameters_{ std::move(parameters) } {}
+            template <std::ranges::viewable_range R>
+            [[nodiscard]] constexpr auto operator()(R&& range) const -> zstd_seekable_decode_view<std::views::all_t<R>, T>
+            {
+                return zstd_seekable_decode_view<std::views::all_t<R>, T>(parameters_, std::views::all(std::forward<R>(range)));
+            }
+        };
+    }
+}
+
+namespace sph::views
+{
+    /**
+     * A range adaptor that represents a random access view of an underlying
+     * seekable zstd compressed sequence after applying zstd decompression.
+     *
+     * The input must be contiguous and in the zstd contrib seekable format,
+     * for example from zstd_encode with
+     * zstd_encode_parameters::seekable_frame_size set. Reading a value only
+     * decompresses the frame that holds it:
+     *
+     * ```c++
+     * auto column{ compressed | sph::views::zstd_seekable_decode<size_t>() };
+     * size_t value{ column[1'000'000] };
+     * ```
+     *
+     * Will throw a std::invalid_argument if the provided range doesn't end
+     * with a valid seek table or a frame doesn't decompress.
+     *
+     * @tparam T The type to decompress into.
+     * @param parameters The zstd decompression parameters.
+     * @return A functor that takes a seekable zstd compressed range and returns a random access view of the decompressed information.
+     */
+    template<typename T = uint8_t>
+    auto zstd_seekable_decode(zstd_decode_parameters const& parameters = {}) -> sph::ranges::views::detail::zstd_seekable_decode_fn<T>
+    {
+        return sph::ranges::views::detail::zstd_seekable_decode_fn<T>{ parameters };
+    }
+}
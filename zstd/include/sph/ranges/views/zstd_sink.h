@@ -0,0 +1,267 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <sph/ranges/views/detail/zstd_compress.h>
+#include <sph/ranges/views/detail/zstd_decompress.h>
+
+namespace sph::ranges::views::detail
+{
+    /**
+     * Where a zstd sink can send its blocks: a callable that takes each block
+     * as a span, or an output iterator the values get copied to.
+     */
+    template<typename O, typename T>
+    concept zstd_sink_output = std::invocable<O&, std::span<T const>> || std::output_iterator<O, T>;
+
+    /**
+     * Hand a block to a sink's output.
+     * @param out The callable or output iterator. An output iterator gets
+     * advanced past the copied values.
+     * @param block The block.
+     */
+    template<typename T, zstd_sink_output<T> O>
+    void zstd_sink_forward(O& out, std::span<T const> block)
+    {
+        if constexpr (std::invocable<O&, std::span<T const>>)
+        {
+            std::invoke(out, block);
+        }
+        else
+        {
+            out = std::ranges::copy(block, std::move(out)).out;
+        }
+    }
+}
+
+namespace sph
+{
+    /**
+     * Compress data pushed at it, for code that gets its data in callbacks
+     * and can't be turned around into an input range.
+     *
+     * Each write() hands a whole span to zstd, which reads it in place, and
+     * the compressed blocks zstd produces go to the output as they appear. A
+     * callable output gets each block as a std::span<uint8_t const> that's
+     * only valid during the call. An output iterator gets the bytes copied
+     * to it.
+     *
+     * Call finish() to end the frame. Writing after finish() starts a new
+     * frame. The parameters that shape a zstd_encode view's output, like
+     * seekable_frame_size, flush_size, and the adaptive level, don't apply.
+     *
+     * ```c++
+     * sph::zstd_encode_sink sink{ [&socket](std::span<uint8_t const> block) { socket.send(block); } };
+     * connection.on_data([&sink](std::span<uint8_t const> data) { sink.write(data); });
+     * connection.on_close([&sink] { sink.finish(); });
+     * ```
+     *
+     * @tparam O The type of the callable or output iterator.
+     * @tparam T The type of the values that get written.
+     */
+    template<typename O, typename T = uint8_t>
+        requires std::is_standard_layout_v<T> && ranges::views::detail::zstd_sink_output<O, uint8_t>
+    class zstd_encode_sink
+    {
+        ranges::views::detail::zstd_compressor compress_;
+        O out_;
+    public:
+        /**
+         * Initialize a new instance of the zstd_encode_sink class.
+         * @param out Where the compressed blocks go.
+         * @param parameters The zstd compression parameters.
+         */
+        explicit zstd_encode_sink(O out, zstd_encode_parameters const& parameters = {})
+            : compress_{ parameters, 0, ranges::views::detail::zstd_staging_size(parameters.out_buffer_size, ZSTD_CStreamOutSize()) }
+            , out_{ std::move(out) } {}
+        zstd_encode_sink(zstd_encode_sink const&) = delete;
+        zstd_encode_sink(zstd_encode_sink&&) = default;
+        ~zstd_encode_sink() = default;
+        auto operator=(zstd_encode_sink const&) -> zstd_encode_sink& = delete;
+        auto operator=(zstd_encode_sink&&) -> zstd_encode_sink& = default;
+
+        /**
+         * Compress the given values. zstd may hold on to some of the
+         * compressed result until a later write(), flush(), or finish().
+         * @param values The values. Only read during the call.
+         */
+        void write(std::span<T const> values)
+        {
+            compress_.in() = ZSTD_inBuffer{ values.data(), values.size_bytes(), 0 };
+            do
+            {
+                run(ZSTD_e_continue);
+            } while (compress_.in().pos < compress_.in().size);
+        }
+
+        /**
+         * Push everything written so far out to the output as a complete
+         * zstd block, so the other end can decompress it without waiting for
+         * more. Costs some compression ratio.
+         */
+        void flush()
+        {
+            while (!run(ZSTD_e_flush))
+            {
+            }
+        }
+
+        /**
+         * End the frame, pushing the rest of the compressed stream out to
+         * the output.
+         */
+        void finish()
+        {
+            while (!run(ZSTD_e_end))
+            {
+            }
+        }
+
+        /**
+         * @return The output; for an output iterator, past the last byte
+         * copied.
+         */
+        [[nodiscard]] auto output() const -> O const& { return out_; }
+
+    private:
+        /**
+         * Run the compressor once and forward what it produced.
+         * @param mode The end directive.
+         * @return True if mode is ZSTD_e_flush or ZSTD_e_end and everything
+         * got pushed out.
+         */
+        auto run(ZSTD_EndDirective mode) -> bool
+        {
+            bool const ret{ compress_(mode) };
+            if (auto const& o{ compress_.out() }; o.size > 0)
+            {
+                ranges::views::detail::zstd_sink_forward(out_, std::span{ static_cast<uint8_t const*>(o.dst), o.size });
+            }
+
+            return ret;
+        }
+    };
+
+    /**
+     * Decompress zstd compressed data pushed at it, for code that gets its
+     * data in callbacks and can't be turned around into an input range.
+     *
+     * Each write() hands a whole span to zstd, which reads it in place, and
+     * the decompressed blocks go to the output as they appear. A callable
+     * output gets each block as a std::span<T const> that's only valid
+     * during the call. An output iterator gets the values copied to it. A
+     * value split across two blocks of zstd output gets held back and sent
+     * whole with the next block.
+     *
+     * Compressed data can come in pieces of any size and hold any number of
+     * frames. Call finish() at the end to check that the data didn't stop in
+     * the middle of a frame or of a value.
+     *
+     * Will throw std::invalid_argument if the written data isn't a valid
+     * zstd compressed stream.
+     *
+     * @tparam O The type of the callable or output iterator.
+     * @tparam T The type to decompress into.
+     */
+    template<typename O, typename T = uint8_t>
+        requires std::is_standard_layout_v<T> && ranges::views::detail::zstd_sink_output<O, T>
+    class zstd_decode_sink
+    {
+        ranges::views::detail::zstd_decompressor decompress_;
+        O out_;
+        size_t keep_{ 0 };
+        bool full_{ false };
+        bool frame_complete_{ true };
+    public:
+        /**
+         * Initialize a new instance of the zstd_decode_sink class.
+         * @param out Where the decompressed blocks go.
+         * @param parameters The zstd decompression parameters.
+         */
+        explicit zstd_decode_sink(O out, zstd_decode_parameters const& parameters = {})
+            : decompress_{ parameters, 0, ranges::views::detail::zstd_staging_size(parameters.out_buffer_size, ZSTD_DStreamOutSize()) }
+            , out_{ std::move(out) } {}
+        zstd_decode_sink(zstd_decode_sink const&) = delete;
+        zstd_decode_sink(zstd_decode_sink&&) = default;
+        ~zstd_decode_sink() = default;
+        auto operator=(zstd_decode_sink const&) -> zstd_decode_sink& = delete;
+        auto operator=(zstd_decode_sink&&) -> zstd_decode_sink& = default;
+
+        /**
+         * Decompress the given compressed bytes.
+         * @param compressed The next piece of the compressed stream. Only
+         * read during the call.
+         */
+        void write(std::span<uint8_t const> compressed)
+        {
+            decompress_.in() = ZSTD_inBuffer{ compressed.data(), compressed.size(), 0 };
+            run();
+        }
+
+        /**
+         * Check that the compressed stream ended cleanly.
+         *
+         * Throws std::invalid_argument if it stopped in the middle of a frame
+         * or of a value.
+         */
+        void finish() const
+        {
+            if (keep_ > 0)
+            {
+                throw std::invalid_argument(std::format("zstd_decode_sink: Partial type at end of data. Required {} bytes, received {}.", sizeof(T), keep_));
+            }
+
+            if (!frame_complete_)
+            {
+                throw std::invalid_argument("zstd_decode_sink: Truncated input. Failed decompression at end of input.");
+            }
+        }
+
+        /**
+         * @return The output; for an output iterator, past the last value
+         * copied.
+         */
+        [[nodiscard]] auto output() const -> O const& { return out_; }
+
+    private:
+        /**
+         * Decompress until zstd has consumed all the input and has nothing
+         * left to flush, forwarding whole values as they appear.
+         */
+        void run()
+        {
+            auto& in{ decompress_.in() };
+            auto& out{ decompress_.out() };
+            auto* const dst{ static_cast<uint8_t*>(out.dst) };
+            while (in.pos < in.size || full_)
+            {
+                frame_complete_ = decompress_(keep_);
+                full_ = out.size == decompress_.out_max_size();
+                size_t const count{ out.size / sizeof(T) };
+                if (count > 0)
+                {
+                    ranges::views::detail::zstd_sink_forward(out_, std::span{ static_cast<T const*>(out.dst), count });
+                }
+
+                // a partial value at the end moves to the front to get completed by the next call
+                keep_ = out.size - (count * sizeof(T));
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+                std::memmove(dst, dst + (count * sizeof(T)), keep_);
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+            }
+        }
+    };
+}